@@ -0,0 +1,427 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// In the previous code segment we wrote a very naive vector that could only
+// store `int` values. It had several problems:
+//
+// * It never deleted its dynamic array: it had no destructor.
+//
+// * It copied every element when reallocating.
+//
+// * It reallocated as soon as it became full, even if no other element
+//   was ever going to be added.
+//
+// * It always allocated memory on the free-store, even to store a single
+//   element.
+
+// In this code segment we'll fix all of them, turning it into a template
+// that can store any type.
+
+// ----------------------------------------------------------------
+
+// The first thing we need is a way to customize how the capacity grows.
+// A "growth policy" is a type with a static `grow` function that returns
+// the new capacity, given the current one and the minimum required one.
+
+// Doubling: few reallocations, but up to half of the memory may be unused.
+struct GrowthDouble
+{
+    static std::size_t grow(std::size_t mCapacity, std::size_t mRequired)
+    {
+        std::size_t result{mCapacity * 2};
+        return result < mRequired ? mRequired : result;
+    }
+};
+
+// Growing by 1.5x wastes less memory, at the cost of more reallocations.
+struct GrowthOneAndHalf
+{
+    static std::size_t grow(std::size_t mCapacity, std::size_t mRequired)
+    {
+        std::size_t result{mCapacity + mCapacity / 2};
+        return result < mRequired ? mRequired : result;
+    }
+};
+
+// Exact fit: no memory is wasted, but every insertion past the capacity
+// reallocates. Useful when the final size is known and set with `reserve`.
+struct GrowthExact
+{
+    static std::size_t grow(std::size_t, std::size_t mRequired)
+    {
+        return mRequired;
+    }
+};
+
+// ----------------------------------------------------------------
+
+// `NaiveVector<T, TInline, TGrowth>` stores its first `TInline` elements in
+// an array inside the object itself: no dynamic allocation takes place
+// until that capacity is exceeded.
+
+template <typename T, std::size_t TInline = 4, typename TGrowth = GrowthDouble>
+class NaiveVector
+{
+private:
+    // Uninitialized memory, suitable to store `TInline` objects of type
+    // `T`. Elements are constructed in it with "placement `new`".
+    using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    Storage inlineStorage[TInline > 0 ? TInline : 1];
+
+    T* data;
+    std::size_t size_{0};
+    std::size_t capacity_{TInline};
+
+    T* inlineData() noexcept
+    {
+        return reinterpret_cast<T*>(&inlineStorage[0]);
+    }
+
+    bool isInline() const noexcept
+    {
+        return data == reinterpret_cast<const T*>(&inlineStorage[0]);
+    }
+
+    // Moves `mCount` elements from `mSrc` to the uninitialized memory at
+    // `mDst`, and destroys the source elements.
+    static void relocate(T* mSrc, std::size_t mCount, T* mDst) noexcept(
+        std::is_nothrow_move_constructible<T>::value)
+    {
+        // Trivially copyable types can be copied as raw bytes, in a single
+        // `memcpy` call.
+        relocateImpl(mSrc, mCount, mDst,
+            std::integral_constant<bool,
+                std::is_trivially_copyable<T>::value>{});
+    }
+
+    static void relocateImpl(
+        T* mSrc, std::size_t mCount, T* mDst, std::true_type) noexcept
+    {
+        if(mCount > 0) std::memcpy(mDst, mSrc, mCount * sizeof(T));
+    }
+
+    // Other types are moved, if their move constructor can't throw.
+    // Otherwise they are copied, so that the source elements are still
+    // intact if an exception is thrown.
+    static void relocateImpl(
+        T* mSrc, std::size_t mCount, T* mDst, std::false_type)
+    {
+        std::size_t i{0};
+
+        try
+        {
+            for(; i < mCount; ++i)
+                new(mDst + i) T(std::move_if_noexcept(mSrc[i]));
+        }
+        catch(...)
+        {
+            // Only copies can throw here: the source elements are intact,
+            // we just need to destroy the ones we already constructed.
+            while(i > 0) mDst[--i].~T();
+            throw;
+        }
+
+        for(i = 0; i < mCount; ++i) mSrc[i].~T();
+    }
+
+    // Replaces the current buffer with `mNewData`, whose elements have
+    // already been relocated.
+    void adopt(T* mNewData, std::size_t mNewCapacity) noexcept
+    {
+        if(!isInline()) ::operator delete(data);
+
+        data = mNewData;
+        capacity_ = mNewCapacity;
+    }
+
+    static T* allocate(std::size_t mCapacity)
+    {
+        return static_cast<T*>(::operator new(mCapacity * sizeof(T)));
+    }
+
+    void reallocate(std::size_t mNewCapacity)
+    {
+        T* newData{allocate(mNewCapacity)};
+
+        try
+        {
+            relocate(data, size_, newData);
+        }
+        catch(...)
+        {
+            ::operator delete(newData);
+            throw;
+        }
+
+        adopt(newData, mNewCapacity);
+    }
+
+    // Slow path of `emplace_back`. `mArgs` may refer to an element of this
+    // vector - think `v.push_back(v[0])` - so the new element is
+    // constructed in the new buffer BEFORE the old elements are relocated
+    // and their buffer is freed. `std::vector` does the same.
+    template <typename... TArgs>
+    T& emplaceReallocate(TArgs&&... mArgs)
+    {
+        auto newCapacity(TGrowth::grow(capacity_, size_ + 1));
+        T* newData{allocate(newCapacity)};
+        T* result;
+
+        try
+        {
+            result = new(newData + size_) T(std::forward<TArgs>(mArgs)...);
+        }
+        catch(...)
+        {
+            ::operator delete(newData);
+            throw;
+        }
+
+        try
+        {
+            relocate(data, size_, newData);
+        }
+        catch(...)
+        {
+            result->~T();
+            ::operator delete(newData);
+            throw;
+        }
+
+        adopt(newData, newCapacity);
+        ++size_;
+
+        return *result;
+    }
+
+    void destroyAll() noexcept
+    {
+        for(std::size_t i{0}; i < size_; ++i) data[i].~T();
+        size_ = 0;
+    }
+
+    // Must be called on an empty vector using its inline storage.
+    // Heap buffers are stolen. Inline elements have to be relocated one
+    // by one.
+    void takeFrom(NaiveVector& mX) noexcept(
+        std::is_nothrow_move_constructible<T>::value)
+    {
+        if(mX.isInline())
+        {
+            relocate(mX.data, mX.size_, data);
+            size_ = mX.size_;
+        }
+        else
+        {
+            data = mX.data;
+            size_ = mX.size_;
+            capacity_ = mX.capacity_;
+
+            mX.data = mX.inlineData();
+            mX.capacity_ = TInline;
+        }
+
+        mX.size_ = 0;
+    }
+
+public:
+    NaiveVector() noexcept : data{inlineData()} {}
+
+    NaiveVector(const NaiveVector& mX) : data{inlineData()}
+    {
+        reserve(mX.size_);
+        for(const auto& x : mX) emplace_back(x);
+    }
+
+    NaiveVector(NaiveVector&& mX) noexcept(
+        std::is_nothrow_move_constructible<T>::value)
+        : data{inlineData()}
+    {
+        takeFrom(mX);
+    }
+
+    // `mX` is taken by value: it's either a copy or a moved-from temporary,
+    // whose contents we can take over.
+    NaiveVector& operator=(NaiveVector mX) noexcept(
+        std::is_nothrow_move_constructible<T>::value)
+    {
+        destroyAll();
+        if(!isInline()) ::operator delete(data);
+
+        data = inlineData();
+        capacity_ = TInline;
+
+        takeFrom(mX);
+        return *this;
+    }
+
+    // Unlike the previous naive vector, we free the memory we own.
+    ~NaiveVector()
+    {
+        destroyAll();
+        if(!isInline()) ::operator delete(data);
+    }
+
+    // Makes sure that at least `mCapacity` elements can be stored without
+    // any further reallocation.
+    void reserve(std::size_t mCapacity)
+    {
+        if(mCapacity > capacity_) reallocate(mCapacity);
+    }
+
+    // Constructs an element in place, forwarding `mArgs` to its
+    // constructor. The capacity only grows when an element is added to a
+    // full vector - never eagerly.
+    template <typename... TArgs>
+    T& emplace_back(TArgs&&... mArgs)
+    {
+        if(size_ == capacity_)
+            return emplaceReallocate(std::forward<TArgs>(mArgs)...);
+
+        T* result{new(data + size_) T(std::forward<TArgs>(mArgs)...)};
+        ++size_;
+
+        return *result;
+    }
+
+    void push_back(const T& mX) { emplace_back(mX); }
+    void push_back(T&& mX) { emplace_back(std::move(mX)); }
+
+    void pop_back() noexcept
+    {
+        --size_;
+        data[size_].~T();
+    }
+
+    void clear() noexcept { destroyAll(); }
+
+    std::size_t size() const noexcept { return size_; }
+    std::size_t capacity() const noexcept { return capacity_; }
+    bool empty() const noexcept { return size_ == 0; }
+
+    // Returns `true` if the elements are stored on the free-store.
+    bool onHeap() const noexcept { return !isInline(); }
+
+    T& operator[](std::size_t mI) noexcept { return data[mI]; }
+    const T& operator[](std::size_t mI) const noexcept { return data[mI]; }
+
+    T* begin() noexcept { return data; }
+    T* end() noexcept { return data + size_; }
+    const T* begin() const noexcept { return data; }
+    const T* end() const noexcept { return data + size_; }
+};
+
+// ----------------------------------------------------------------
+
+// A type that prints its special member function calls, to show how
+// elements are relocated.
+struct Example
+{
+    std::string name;
+
+    Example(std::string mName) : name{std::move(mName)} {}
+    Example(const Example& mX) : name{mX.name}
+    {
+        std::cout << "COPY " << name << std::endl;
+    }
+    Example(Example&& mX) noexcept : name{std::move(mX.name)}
+    {
+        std::cout << "MOVE " << name << std::endl;
+    }
+};
+
+void example()
+{
+    NaiveVector<Example, 2> v;
+
+    // Stored inline: no allocation.
+    v.emplace_back("a");
+    v.emplace_back("b");
+    std::cout << "On heap: " << v.onHeap() << std::endl; // Prints "0".
+
+    // The vector is full: the elements are moved to the free-store.
+    // Prints "MOVE a" and "MOVE b", as `Example`'s move constructor is
+    // marked `noexcept`.
+    v.emplace_back("c");
+    std::cout << "On heap: " << v.onHeap() << std::endl; // Prints "1".
+
+    // Appending a copy of one of its own elements to a full vector is
+    // safe: the copy is made before the old buffer goes away.
+    // Prints "COPY a", then the relocation of the four elements.
+    v.emplace_back("d");
+    v.push_back(v[0]);
+    std::cout << v[4].name << std::endl; // Prints "a".
+
+    // `int` is trivially copyable: relocation is a single `memcpy`.
+    NaiveVector<int, 2, GrowthExact> ints;
+    ints.reserve(5);
+
+    for(int i{0}; i < 5; ++i) ints.push_back(i);
+    std::cout << "Capacity: " << ints.capacity() << std::endl; // Prints "5".
+}
+
+// ----------------------------------------------------------------
+
+// Many tiny lists: for example, the list of components of every entity in
+// a game. Most lists have less than 4 elements.
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TList>
+long long tinyLists(std::size_t mCount)
+{
+    std::vector<TList> lists(mCount);
+
+    for(std::size_t i{0}; i < mCount; ++i)
+        for(std::size_t j{0}; j < i % 5; ++j)
+            lists[i].push_back(static_cast<int>(i + j));
+
+    long long result{0};
+    for(const auto& l : lists)
+        for(auto x : l) result += x;
+
+    return result;
+}
+
+template <typename TList>
+void bench(const char* mTitle, std::size_t mCount)
+{
+    auto start(HRClock::now());
+    auto result(tinyLists<TList>(mCount));
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+              << ")" << std::endl;
+}
+
+int main()
+{
+    example();
+
+    std::size_t count{2000000};
+    std::cout << count << " lists of 0 to 4 `int` values" << std::endl;
+
+    bench<std::vector<int>>("std::vector<int>", count);
+    bench<NaiveVector<int, 4, GrowthDouble>>("NaiveVector<int, 4>", count);
+    bench<NaiveVector<int, 4, GrowthOneAndHalf>>(
+        "NaiveVector<int, 4, GrowthOneAndHalf>", count);
+    bench<NaiveVector<int, 0, GrowthDouble>>("NaiveVector<int, 0>", count);
+
+    return 0;
+}
+
+// With inline storage, most lists never touch the free-store - and the
+// elements live right next to the list itself, in the same cache line.
@@ -0,0 +1,429 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// In the previous code segments, every dynamically-allocated object was
+// created with `new` and destroyed with `delete`. Every one of those calls
+// goes through the general-purpose allocator, which must handle objects of
+// any size, allocated and freed in any order.
+
+// Most objects in a game, however, follow much simpler patterns:
+//
+// * Temporary objects that only live for the current frame.
+//
+// * Many objects of the same size, created and destroyed all the time.
+
+// In this code segment we'll write three allocators that exploit these
+// patterns:
+//
+// * `LinearArena`: allocating is just "bumping" an offset into a big
+//   buffer. Individual objects are never freed: the whole arena is reset
+//   at once.
+//
+// * `FrameArena`: two linear arenas used alternately, one per frame.
+//   Objects allocated during a frame stay valid until the end of the next
+//   one.
+//
+// * `PoolAllocator`: a buffer divided in fixed-size blocks. Free blocks
+//   are kept in a linked list, so that allocating and freeing a block are
+//   both a couple of pointer assignments.
+//
+// All of them can be used with standard containers through
+// `ArenaAllocator`, track their peak usage, and fill memory with
+// recognizable "poison" patterns in debug builds, to make use-after-free
+// bugs easier to spot.
+
+// ----------------------------------------------------------------
+
+// Debug poisoning: freshly allocated memory is filled with `0xCD`, freed
+// memory with `0xDD`. Disabled when `NDEBUG` is defined.
+#ifndef NDEBUG
+inline void poison(void* mPtr, std::size_t mBytes, unsigned char mPattern)
+{
+    std::memset(mPtr, mPattern, mBytes);
+}
+#else
+inline void poison(void*, std::size_t, unsigned char) {}
+#endif
+
+constexpr unsigned char allocatedPattern{0xCD};
+constexpr unsigned char freedPattern{0xDD};
+
+struct AllocatorStats
+{
+    std::size_t used{0};
+    std::size_t peak{0};
+    std::size_t allocations{0};
+
+    void onAllocate(std::size_t mBytes)
+    {
+        used += mBytes;
+        ++allocations;
+        if(used > peak) peak = used;
+    }
+};
+
+inline std::size_t alignUp(std::size_t mX, std::size_t mAlign)
+{
+    return (mX + mAlign - 1) & ~(mAlign - 1);
+}
+
+// ----------------------------------------------------------------
+
+class LinearArena
+{
+private:
+    std::unique_ptr<char[]> buffer;
+    std::size_t capacity;
+    std::size_t offset{0};
+    AllocatorStats stats;
+
+public:
+    explicit LinearArena(std::size_t mCapacity)
+        : buffer{new char[mCapacity]}, capacity{mCapacity}
+    {
+    }
+
+    // Throws `std::bad_alloc` when the arena is exhausted.
+    void* allocate(std::size_t mBytes, std::size_t mAlign)
+    {
+        // The buffer returned by `new char[]` is suitably aligned for any
+        // fundamental type: aligning the offset is enough.
+        std::size_t begin{alignUp(offset, mAlign)};
+        if(begin + mBytes > capacity) throw std::bad_alloc{};
+
+        offset = begin + mBytes;
+        stats.onAllocate(mBytes);
+
+        void* result{buffer.get() + begin};
+        poison(result, mBytes, allocatedPattern);
+
+        return result;
+    }
+
+    // Individual deallocations are ignored.
+    void deallocate(void*, std::size_t) noexcept {}
+
+    // Frees everything at once. Destructors are NOT called: only objects
+    // with trivial destructors, or already-destroyed objects, should be
+    // left in the arena.
+    void reset() noexcept
+    {
+        poison(buffer.get(), offset, freedPattern);
+        offset = 0;
+        stats.used = 0;
+    }
+
+    const AllocatorStats& getStats() const noexcept { return stats; }
+};
+
+class FrameArena
+{
+private:
+    LinearArena arenas[2];
+    std::size_t current{0};
+
+public:
+    explicit FrameArena(std::size_t mCapacityPerFrame)
+        : arenas{LinearArena{mCapacityPerFrame},
+              LinearArena{mCapacityPerFrame}}
+    {
+    }
+
+    // Called at the beginning of every frame: the arena used two frames
+    // ago is reset and becomes the current one.
+    void beginFrame() noexcept
+    {
+        current = 1 - current;
+        arenas[current].reset();
+    }
+
+    void* allocate(std::size_t mBytes, std::size_t mAlign)
+    {
+        return arenas[current].allocate(mBytes, mAlign);
+    }
+
+    void deallocate(void*, std::size_t) noexcept {}
+
+    const AllocatorStats& getStats() const noexcept
+    {
+        return arenas[current].getStats();
+    }
+};
+
+class PoolAllocator
+{
+private:
+    // Free blocks store a pointer to the next free block.
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    std::unique_ptr<char[]> buffer;
+    std::size_t blockSize;
+    FreeBlock* freeList{nullptr};
+    AllocatorStats stats;
+
+public:
+    PoolAllocator(std::size_t mBlockSize, std::size_t mBlockCount)
+        : blockSize{alignUp(mBlockSize < sizeof(FreeBlock) ? sizeof(FreeBlock)
+                                                           : mBlockSize,
+              alignof(std::max_align_t))}
+    {
+        buffer.reset(new char[blockSize * mBlockCount]);
+
+        // Initially, every block is free.
+        for(std::size_t i{mBlockCount}; i > 0; --i)
+        {
+            auto block(reinterpret_cast<FreeBlock*>(
+                buffer.get() + (i - 1) * blockSize));
+
+            block->next = freeList;
+            freeList = block;
+        }
+    }
+
+    // Throws `std::bad_alloc` when the request doesn't fit in a block, or
+    // when there are no free blocks left.
+    void* allocate(std::size_t mBytes, std::size_t mAlign)
+    {
+        if(mBytes > blockSize || mAlign > alignof(std::max_align_t) ||
+            freeList == nullptr)
+            throw std::bad_alloc{};
+
+        void* result{freeList};
+        freeList = freeList->next;
+        stats.onAllocate(blockSize);
+
+        poison(result, blockSize, allocatedPattern);
+        return result;
+    }
+
+    void deallocate(void* mPtr, std::size_t) noexcept
+    {
+        poison(mPtr, blockSize, freedPattern);
+
+        auto block(static_cast<FreeBlock*>(mPtr));
+        block->next = freeList;
+        freeList = block;
+
+        stats.used -= blockSize;
+    }
+
+    const AllocatorStats& getStats() const noexcept { return stats; }
+};
+
+// ----------------------------------------------------------------
+
+// `ArenaAllocator<T, TArena>` adapts any of the allocators above to the
+// interface required by standard containers. It only stores a pointer to
+// the arena, which must outlive the container.
+template <typename T, typename TArena>
+class ArenaAllocator
+{
+    template <typename, typename>
+    friend class ArenaAllocator;
+
+private:
+    TArena* arena;
+
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(TArena& mArena) noexcept : arena{&mArena} {}
+
+    // Containers "rebind" the allocator to allocate their internal nodes.
+    template <typename TU>
+    ArenaAllocator(const ArenaAllocator<TU, TArena>& mX) noexcept
+        : arena{mX.arena}
+    {
+    }
+
+    T* allocate(std::size_t mN)
+    {
+        return static_cast<T*>(arena->allocate(mN * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* mPtr, std::size_t mN) noexcept
+    {
+        arena->deallocate(mPtr, mN * sizeof(T));
+    }
+
+    template <typename TU>
+    bool operator==(const ArenaAllocator<TU, TArena>& mX) const noexcept
+    {
+        return arena == mX.arena;
+    }
+
+    template <typename TU>
+    bool operator!=(const ArenaAllocator<TU, TArena>& mX) const noexcept
+    {
+        return arena != mX.arena;
+    }
+};
+
+// Constructs a `T` in memory obtained from an arena.
+template <typename T, typename TArena, typename... TArgs>
+T* create(TArena& mArena, TArgs&&... mArgs)
+{
+    return new(mArena.allocate(sizeof(T), alignof(T)))
+        T(std::forward<TArgs>(mArgs)...);
+}
+
+template <typename T, typename TArena>
+void destroy(TArena& mArena, T* mPtr) noexcept
+{
+    mPtr->~T();
+    mArena.deallocate(mPtr, sizeof(T));
+}
+
+// ----------------------------------------------------------------
+
+// Similar to the `Example` class of the previous code segment, without
+// the printing.
+struct Example
+{
+    int id;
+    Example(int mId) : id{mId} {}
+};
+
+void example()
+{
+    FrameArena frameArena{1024 * 1024};
+
+    for(int frame{0}; frame < 3; ++frame)
+    {
+        frameArena.beginFrame();
+
+        // A temporary list of visible object ids, built every frame.
+        // All of its memory comes from the frame arena.
+        std::vector<int, ArenaAllocator<int, FrameArena>> visible{
+            ArenaAllocator<int, FrameArena>{frameArena}};
+
+        for(int i{0}; i < 100; ++i) visible.push_back(i);
+
+        std::cout << "Frame " << frame << ": "
+                  << frameArena.getStats().peak << " bytes peak"
+                  << std::endl;
+    }
+
+    // A pool is a good fit for node-based containers, as all nodes have
+    // the same size.
+    PoolAllocator pool{sizeof(int) + 2 * sizeof(void*), 1000};
+
+    {
+        std::list<int, ArenaAllocator<int, PoolAllocator>> l{
+            ArenaAllocator<int, PoolAllocator>{pool}};
+
+        for(int i{0}; i < 10; ++i) l.push_back(i);
+        std::cout << "Pool: " << pool.getStats().used << " bytes used"
+                  << std::endl;
+    }
+
+    // All nodes have been returned to the pool. Prints "0".
+    std::cout << "Pool: " << pool.getStats().used << " bytes used"
+              << std::endl;
+}
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* mTitle, TF&& mFn)
+{
+    auto start(HRClock::now());
+    auto result(mFn());
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+              << ")" << std::endl;
+}
+
+// Every frame, `mCount` `Example` objects are created, used, and
+// destroyed.
+void benchmark(std::size_t mFrames, std::size_t mCount)
+{
+    std::cout << mFrames << " frames, " << mCount << " objects per frame"
+              << std::endl;
+
+    std::vector<Example*> objects(mCount);
+
+    bench("new/delete", [&]
+        {
+            long long sum{0};
+
+            for(std::size_t f{0}; f < mFrames; ++f)
+            {
+                for(std::size_t i{0}; i < mCount; ++i)
+                    objects[i] = new Example{static_cast<int>(i)};
+
+                for(auto o : objects) sum += o->id;
+                for(auto o : objects) delete o;
+            }
+
+            return sum;
+        });
+
+    FrameArena frameArena{mCount * sizeof(Example)};
+
+    bench("FrameArena", [&]
+        {
+            long long sum{0};
+
+            for(std::size_t f{0}; f < mFrames; ++f)
+            {
+                frameArena.beginFrame();
+
+                for(std::size_t i{0}; i < mCount; ++i)
+                    objects[i] =
+                        create<Example>(frameArena, static_cast<int>(i));
+
+                for(auto o : objects) sum += o->id;
+
+                // `Example` is trivially destructible: nothing to do, the
+                // memory is reclaimed by the next `beginFrame` call.
+            }
+
+            return sum;
+        });
+
+    PoolAllocator pool{sizeof(Example), mCount};
+
+    bench("PoolAllocator", [&]
+        {
+            long long sum{0};
+
+            for(std::size_t f{0}; f < mFrames; ++f)
+            {
+                for(std::size_t i{0}; i < mCount; ++i)
+                    objects[i] = create<Example>(pool, static_cast<int>(i));
+
+                for(auto o : objects) sum += o->id;
+                for(auto o : objects) destroy(pool, o);
+            }
+
+            return sum;
+        });
+}
+
+int main()
+{
+    example();
+    benchmark(1000, 10000);
+
+    return 0;
+}
+
+// Compile with `-DNDEBUG` to disable poisoning before measuring: filling
+// memory on every allocation is not free.
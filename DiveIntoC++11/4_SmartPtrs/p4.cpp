@@ -0,0 +1,377 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// In the previous code segment, many `TexturedObject` instances shared a
+// single `TextureResource` through `std::shared_ptr`. But someone still
+// had to create the resource, and make sure it was created only once.
+
+// In this code segment we'll write an `AssetCache`: objects ask the cache
+// for a resource by key, and get a shared handle to it.
+//
+// * A resource is loaded at most once, even if many threads request it at
+//   the same time.
+//
+// * When its last handle is destroyed, the resource is not freed: it is
+//   kept "idle" in a least-recently-used (LRU) list, so that requesting it
+//   again is free.
+//
+// * Idle resources are freed, least-recently-used first, only when the
+//   total memory used by the cache exceeds a budget.
+
+// (Remember to compile this code segment with `-pthread`.)
+
+template <typename TKey, typename TResource>
+class AssetCache
+{
+public:
+    using Handle = std::shared_ptr<TResource>;
+    using Loader = std::function<std::unique_ptr<TResource>(const TKey&)>;
+    using SizeOf = std::function<std::size_t(const TResource&)>;
+
+private:
+    struct Entry
+    {
+        // The cache always owns the resource...
+        std::unique_ptr<TResource> resource;
+
+        // ...and gives out handles with their own reference counter. We
+        // only keep a `std::weak_ptr` to them: when it expires, the
+        // resource has no more users.
+        std::weak_ptr<TResource> users;
+
+        // Number of handles whose `Release` hasn't run yet. See
+        // `Release`.
+        std::size_t handles{0};
+
+        std::size_t bytes{0};
+        bool loading{true};
+        bool idle{false};
+
+        // The entry's LRU list node, allocated when the resource is
+        // loaded. It is spliced into `State::lru` while the entry is idle,
+        // and lives here otherwise: becoming idle never allocates.
+        std::list<TKey> lruNode;
+        typename std::list<TKey>::iterator lruPosition;
+    };
+
+    // The state is shared with the deleters of the handles: it stays alive
+    // until both the cache and all of its handles have been destroyed.
+    struct State
+    {
+        Loader loader;
+        SizeOf sizeOf;
+        std::size_t budget;
+
+        std::mutex mutex;
+        std::condition_variable loaded;
+        std::unordered_map<TKey, Entry> entries;
+
+        // Idle resources, the most recently used one first.
+        std::list<TKey> lru;
+
+        std::size_t residentBytes{0};
+        std::size_t loads{0}, hits{0}, evictions{0};
+
+        // Frees idle resources until the budget is respected, or there are
+        // no more idle resources. Resources in use are never freed.
+        void evict()
+        {
+            while(residentBytes > budget && !lru.empty())
+            {
+                auto itr(entries.find(lru.back()));
+                residentBytes -= itr->second.bytes;
+                ++evictions;
+
+                lru.pop_back();
+                entries.erase(itr);
+            }
+        }
+    };
+
+    // Custom deleter of the handles. It does not delete the resource: it
+    // tells the cache that the resource is now idle.
+    struct Release
+    {
+        std::shared_ptr<State> state;
+        TKey key;
+
+        // Deleters of `std::shared_ptr` must not throw: nothing below
+        // allocates.
+        void operator()(TResource*) const
+        {
+            std::lock_guard<std::mutex> lock{state->mutex};
+
+            // The entry can't have been evicted: it is never idle while
+            // one of its `Release`s is pending.
+            auto& e(state->entries.find(key)->second);
+
+            // A new handle may have been created between the moment the
+            // old one expired and the moment we acquired the lock: in that
+            // case the resource is in use again. Waiting for every
+            // `Release` also guarantees that the resource is only freed
+            // after its last user is done with it.
+            if(--e.handles > 0) return;
+
+            e.idle = true;
+            state->lru.splice(state->lru.begin(), e.lruNode);
+            e.lruPosition = state->lru.begin();
+
+            state->evict();
+        }
+    };
+
+    std::shared_ptr<State> state;
+
+    // Creates a new handle for an entry that has no users.
+    // Must be called with the mutex locked.
+    Handle makeHandle(const TKey& mKey, Entry& mEntry)
+    {
+        if(mEntry.idle)
+        {
+            mEntry.lruNode.splice(
+                mEntry.lruNode.end(), state->lru, mEntry.lruPosition);
+            mEntry.idle = false;
+        }
+
+        Handle result{mEntry.resource.get(), Release{state, mKey}};
+
+        ++mEntry.handles;
+        mEntry.users = result;
+        return result;
+    }
+
+public:
+    AssetCache(Loader mLoader, SizeOf mSizeOf, std::size_t mBudget)
+        : state{std::make_shared<State>()}
+    {
+        state->loader = std::move(mLoader);
+        state->sizeOf = std::move(mSizeOf);
+        state->budget = mBudget;
+    }
+
+    AssetCache(const AssetCache&) = delete;
+    AssetCache& operator=(const AssetCache&) = delete;
+
+    Handle get(const TKey& mKey)
+    {
+        std::unique_lock<std::mutex> lock{state->mutex};
+
+        while(true)
+        {
+            auto itr(state->entries.find(mKey));
+            if(itr == state->entries.end()) break;
+
+            auto& e(itr->second);
+
+            // Another thread is loading this resource: wait for it, then
+            // look the key up again. (The load may have failed.)
+            if(e.loading)
+            {
+                state->loaded.wait(lock);
+                continue;
+            }
+
+            ++state->hits;
+
+            Handle result{e.users.lock()};
+            return result != nullptr ? result : makeHandle(mKey, e);
+        }
+
+        // The resource is not in the cache: we reserve its entry, so that
+        // other threads requesting it will wait, and load it without
+        // holding the lock.
+        state->entries[mKey];
+        ++state->loads;
+        lock.unlock();
+
+        std::unique_ptr<TResource> resource;
+        std::size_t bytes;
+        std::list<TKey> lruNode;
+
+        try
+        {
+            resource = state->loader(mKey);
+            if(resource == nullptr)
+                throw std::runtime_error{"AssetCache: loader returned null"};
+
+            bytes = state->sizeOf(*resource);
+            lruNode.push_back(mKey);
+        }
+        catch(...)
+        {
+            lock.lock();
+            state->entries.erase(mKey);
+            state->loaded.notify_all();
+            throw;
+        }
+
+        lock.lock();
+
+        auto& e(state->entries[mKey]);
+        e.resource = std::move(resource);
+        e.bytes = bytes;
+        e.lruNode.splice(e.lruNode.end(), lruNode);
+        e.loading = false;
+
+        state->residentBytes += bytes;
+        state->evict();
+        state->loaded.notify_all();
+
+        return makeHandle(mKey, e);
+    }
+
+    // Frees all idle resources.
+    void trim()
+    {
+        std::lock_guard<std::mutex> lock{state->mutex};
+
+        auto budget(state->budget);
+        state->budget = 0;
+        state->evict();
+        state->budget = budget;
+    }
+
+    std::size_t residentBytes() const
+    {
+        std::lock_guard<std::mutex> lock{state->mutex};
+        return state->residentBytes;
+    }
+
+    std::size_t loads() const
+    {
+        std::lock_guard<std::mutex> lock{state->mutex};
+        return state->loads;
+    }
+
+    std::size_t hits() const
+    {
+        std::lock_guard<std::mutex> lock{state->mutex};
+        return state->hits;
+    }
+
+    std::size_t evictions() const
+    {
+        std::lock_guard<std::mutex> lock{state->mutex};
+        return state->evictions;
+    }
+};
+
+// ----------------------------------------------------------------
+
+struct TextureResource
+{
+    std::string path;
+    std::vector<char> pixels;
+
+    TextureResource(std::string mPath, std::size_t mBytes)
+        : path{std::move(mPath)}, pixels(mBytes)
+    {
+        std::cout << "CTOR " << path << std::endl;
+    }
+
+    ~TextureResource() { std::cout << "DTOR " << path << std::endl; }
+
+    TextureResource(const TextureResource&) = delete;
+    TextureResource& operator=(const TextureResource&) = delete;
+};
+
+struct TexturedObject
+{
+    std::shared_ptr<TextureResource> texture;
+};
+
+using TextureCache = AssetCache<std::string, TextureResource>;
+
+constexpr std::size_t megabyte{1024 * 1024};
+
+std::unique_ptr<TextureResource> loadTexture(const std::string& mPath)
+{
+    // Simulates a slow load from disk.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return std::unique_ptr<TextureResource>{
+        new TextureResource{mPath, megabyte}};
+}
+
+std::size_t textureSize(const TextureResource& mTexture)
+{
+    return mTexture.pixels.size();
+}
+
+void printStats(const TextureCache& mCache)
+{
+    std::cout << "Resident: " << mCache.residentBytes() / megabyte
+              << " MB, loads: " << mCache.loads()
+              << ", hits: " << mCache.hits()
+              << ", evictions: " << mCache.evictions() << std::endl;
+}
+
+int main()
+{
+    // At most 2 MB of textures, unless more are in use.
+    TextureCache cache{loadTexture, textureSize, 2 * megabyte};
+
+    {
+        // Prints "CTOR a.png" only once.
+        TexturedObject to1{cache.get("a.png")};
+        TexturedObject to2{cache.get("a.png")};
+        TexturedObject to3{cache.get("b.png")};
+    }
+
+    // The handles have been destroyed, but "DTOR" wasn't printed: both
+    // textures are idle, and within budget.
+
+    // Requesting `a.png` again is free: "CTOR" is not printed.
+    {
+        TexturedObject to4{cache.get("a.png")};
+    }
+
+    // Loading `c.png` exceeds the budget: the least recently used idle
+    // texture, `b.png`, is freed. Prints "CTOR c.png" and "DTOR b.png".
+    {
+        TexturedObject to5{cache.get("c.png")};
+    }
+
+    printStats(cache);
+
+    // Many threads requesting the same texture at the same time: it's
+    // loaded only once. Prints "CTOR d.png" once.
+    {
+        std::vector<std::thread> threads;
+        std::vector<TexturedObject> objects(8);
+
+        for(auto& o : objects)
+            threads.emplace_back([&cache, &o]
+                {
+                    o.texture = cache.get("d.png");
+                });
+
+        for(auto& t : threads) t.join();
+    }
+
+    printStats(cache);
+
+    // Frees all idle textures.
+    cache.trim();
+    printStats(cache);
+
+    return 0;
+}
+
+// The cache frees resources only when it must, and never the ones that are
+// still in use: `std::shared_ptr`'s custom deleters let us know exactly
+// when a resource stops being used.
@@ -0,0 +1,424 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Sometimes an object needs to refer to a shared resource without keeping
+// it alive: a render list, or a UI widget showing a texture, should not
+// prevent the texture from being freed. The standard library offers
+// `std::weak_ptr` for this: it "observes" a resource owned by
+// `std::shared_ptr` instances, and `lock()` returns a new `std::shared_ptr`
+// if the resource is still alive.
+
+// When hundreds of thousands of weak references are upgraded every frame,
+// `lock()` starts to show up in profiles. In this code segment we'll write
+// our own shared and weak handles, `Strong<T>` and `Weak<T>`, where:
+//
+// * The counters and the resource share a single allocation, so upgrading
+//   touches a single cache line.
+//
+// * Upgrading is a lock-free "increment if not zero" loop.
+//
+// * A whole list of weak references can be upgraded at once: consecutive
+//   references to the same resource - very common in render lists sorted
+//   by texture - are upgraded with a single atomic operation.
+
+// (Remember to compile this code segment with `-pthread`.)
+
+// ----------------------------------------------------------------
+
+// A "control block" storing the counters and the resource itself.
+// The resource is destroyed when the last `Strong` handle goes away, the
+// block is freed when the last `Weak` handle goes away.
+template <typename T>
+struct ControlBlock
+{
+    // Number of `Strong` handles.
+    std::atomic<std::size_t> strong{1};
+
+    // Number of `Weak` handles, plus one for all the `Strong` handles
+    // together.
+    std::atomic<std::size_t> weak{1};
+
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+    T* get() noexcept { return reinterpret_cast<T*>(&storage); }
+
+    void releaseStrong() noexcept
+    {
+        if(strong.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+        get()->~T();
+        releaseWeak();
+    }
+
+    void releaseWeak() noexcept
+    {
+        if(weak.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+    }
+
+    // Adds `mCount` strong references, unless the resource has already
+    // been destroyed. Never blocks: if another thread changes the counter
+    // in the meantime, we simply retry.
+    bool tryAcquireStrong(std::size_t mCount) noexcept
+    {
+        std::size_t n{strong.load(std::memory_order_relaxed)};
+
+        while(n != 0)
+            if(strong.compare_exchange_weak(n, n + mCount,
+                   std::memory_order_acquire, std::memory_order_relaxed))
+                return true;
+
+        return false;
+    }
+};
+
+template <typename T>
+class Weak;
+
+template <typename T>
+class Strong
+{
+    template <typename>
+    friend class Weak;
+
+    template <typename TU, typename... TArgs>
+    friend Strong<TU> makeStrong(TArgs&&...);
+
+private:
+    ControlBlock<T>* block{nullptr};
+
+    // Adopts a strong reference that has already been counted.
+    explicit Strong(ControlBlock<T>* mBlock) noexcept : block{mBlock} {}
+
+public:
+    Strong() noexcept = default;
+
+    Strong(const Strong& mX) noexcept : block{mX.block}
+    {
+        if(block != nullptr)
+            block->strong.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Strong(Strong&& mX) noexcept : block{mX.block} { mX.block = nullptr; }
+
+    Strong& operator=(Strong mX) noexcept
+    {
+        std::swap(block, mX.block);
+        return *this;
+    }
+
+    ~Strong()
+    {
+        if(block != nullptr) block->releaseStrong();
+    }
+
+    T* get() const noexcept
+    {
+        return block != nullptr ? block->get() : nullptr;
+    }
+
+    T& operator*() const noexcept { return *get(); }
+    T* operator->() const noexcept { return get(); }
+    explicit operator bool() const noexcept { return block != nullptr; }
+};
+
+template <typename T, typename... TArgs>
+Strong<T> makeStrong(TArgs&&... mArgs)
+{
+    std::unique_ptr<ControlBlock<T>> block{new ControlBlock<T>};
+    new(block->get()) T(std::forward<TArgs>(mArgs)...);
+
+    return Strong<T>{block.release()};
+}
+
+template <typename T>
+class Weak
+{
+private:
+    ControlBlock<T>* block{nullptr};
+
+public:
+    Weak() noexcept = default;
+
+    Weak(const Strong<T>& mX) noexcept : block{mX.block}
+    {
+        if(block != nullptr)
+            block->weak.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Weak(const Weak& mX) noexcept : block{mX.block}
+    {
+        if(block != nullptr)
+            block->weak.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Weak(Weak&& mX) noexcept : block{mX.block} { mX.block = nullptr; }
+
+    Weak& operator=(Weak mX) noexcept
+    {
+        std::swap(block, mX.block);
+        return *this;
+    }
+
+    ~Weak()
+    {
+        if(block != nullptr) block->releaseWeak();
+    }
+
+    // Cheap check, without upgrading. The answer may be outdated as soon
+    // as it is returned, if other threads own the resource.
+    bool expired() const noexcept
+    {
+        return block == nullptr ||
+               block->strong.load(std::memory_order_relaxed) == 0;
+    }
+
+    // Returns an empty `Strong` if the resource has been destroyed.
+    Strong<T> lock() const noexcept
+    {
+        return block != nullptr && block->tryAcquireStrong(1)
+                   ? Strong<T>{block}
+                   : Strong<T>{};
+    }
+
+    // Upgrades every weak reference in `[mBegin, mEnd)`, appending the
+    // live ones to `mOut`. Runs of references to the same resource are
+    // upgraded with a single atomic operation. Returns the number of
+    // expired references that were skipped.
+    template <typename TItr, typename TOut>
+    static std::size_t lockAll(TItr mBegin, TItr mEnd, TOut& mOut)
+    {
+        std::size_t expiredCount{0};
+
+        while(mBegin != mEnd)
+        {
+            auto b(mBegin->block);
+
+            std::size_t run{1};
+            for(++mBegin; mBegin != mEnd && mBegin->block == b; ++mBegin)
+                ++run;
+
+            if(b == nullptr || !b->tryAcquireStrong(run))
+            {
+                expiredCount += run;
+                continue;
+            }
+
+            // The references have already been counted: we only need to
+            // create the handles. Every handle owns one of them as soon as
+            // it is created - if `mOut` throws, the ones that haven't been
+            // adopted yet must be given back, or the resource would leak.
+            std::size_t adopted{0};
+
+            try
+            {
+                while(adopted < run)
+                {
+                    Strong<T> s{b};
+                    ++adopted;
+
+                    mOut.push_back(std::move(s));
+                }
+            }
+            catch(...)
+            {
+                for(; adopted < run; ++adopted) b->releaseStrong();
+                throw;
+            }
+        }
+
+        return expiredCount;
+    }
+};
+
+// ----------------------------------------------------------------
+
+struct TextureResource
+{
+    int id;
+    char pixels[64];
+
+    TextureResource(int mId) : id{mId} {}
+};
+
+void example()
+{
+    Weak<TextureResource> observer;
+
+    {
+        auto texture(makeStrong<TextureResource>(42));
+        observer = texture;
+
+        // Prints "42".
+        std::cout << observer.lock()->id << std::endl;
+    }
+
+    // The last `Strong` handle is gone: the texture has been destroyed,
+    // even if `observer` is still around. Prints "1".
+    std::cout << observer.expired() << std::endl;
+
+    // `lockAll` must not leak references if the output container throws
+    // halfway through a run.
+    struct FullList
+    {
+        std::vector<Strong<TextureResource>> items;
+
+        void push_back(Strong<TextureResource>&& mX)
+        {
+            if(items.size() == 2) throw std::bad_alloc{};
+            items.push_back(std::move(mX));
+        }
+    };
+
+    {
+        auto texture(makeStrong<TextureResource>(7));
+        std::vector<Weak<TextureResource>> refs(
+            4, Weak<TextureResource>{texture});
+
+        observer = texture;
+
+        try
+        {
+            FullList list;
+            Weak<TextureResource>::lockAll(refs.begin(), refs.end(), list);
+        }
+        catch(const std::bad_alloc&)
+        {
+        }
+    }
+
+    // Prints "1".
+    std::cout << observer.expired() << std::endl;
+}
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* mTitle, TF&& mFn)
+{
+    auto start(HRClock::now());
+    auto result(mFn());
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+              << ")" << std::endl;
+}
+
+// A render list of `mRefs` weak references to `mTextures` textures, sorted
+// by texture. One texture in ten has been destroyed.
+void benchmark(std::size_t mFrames, std::size_t mTextures, std::size_t mRefs)
+{
+    std::cout << mFrames << " frames, " << mRefs << " weak references to "
+              << mTextures << " textures" << std::endl;
+
+    std::vector<std::shared_ptr<TextureResource>> stdOwners;
+    std::vector<Strong<TextureResource>> owners;
+
+    for(std::size_t i{0}; i < mTextures; ++i)
+    {
+        stdOwners.emplace_back(
+            std::make_shared<TextureResource>(static_cast<int>(i)));
+        owners.emplace_back(
+            makeStrong<TextureResource>(static_cast<int>(i)));
+    }
+
+    std::vector<std::weak_ptr<TextureResource>> stdRefs;
+    std::vector<Weak<TextureResource>> refs;
+
+    for(std::size_t i{0}; i < mRefs; ++i)
+    {
+        auto t(i * mTextures / mRefs);
+        stdRefs.emplace_back(stdOwners[t]);
+        refs.emplace_back(owners[t]);
+    }
+
+    for(std::size_t i{0}; i < mTextures; i += 10)
+    {
+        stdOwners[i].reset();
+        owners[i] = Strong<TextureResource>{};
+    }
+
+    std::vector<std::shared_ptr<TextureResource>> stdVisible;
+    std::vector<Strong<TextureResource>> visible;
+    stdVisible.reserve(mRefs);
+    visible.reserve(mRefs);
+
+    bench("std::weak_ptr::lock", [&]
+        {
+            long long sum{0};
+
+            for(std::size_t f{0}; f < mFrames; ++f)
+            {
+                for(const auto& r : stdRefs)
+                    if(auto s = r.lock()) stdVisible.push_back(std::move(s));
+
+                for(const auto& s : stdVisible) sum += s->id;
+                stdVisible.clear();
+            }
+
+            return sum;
+        });
+
+    bench("Weak::lock", [&]
+        {
+            long long sum{0};
+
+            for(std::size_t f{0}; f < mFrames; ++f)
+            {
+                for(const auto& r : refs)
+                    if(auto s = r.lock()) visible.push_back(std::move(s));
+
+                for(const auto& s : visible) sum += s->id;
+                visible.clear();
+            }
+
+            return sum;
+        });
+
+    bench("Weak::lockAll", [&]
+        {
+            long long sum{0};
+
+            for(std::size_t f{0}; f < mFrames; ++f)
+            {
+                Weak<TextureResource>::lockAll(
+                    refs.begin(), refs.end(), visible);
+
+                for(const auto& s : visible) sum += s->id;
+                visible.clear();
+            }
+
+            return sum;
+        });
+}
+
+int main()
+{
+    example();
+
+    // Some standard libraries make `std::shared_ptr` non-atomic as long as
+    // the program has never started a thread: let's start one, so that
+    // we compare atomic operations with atomic operations.
+    std::thread{[]
+        {
+        }}.join();
+
+    benchmark(100, 1000, 100000);
+    return 0;
+}
+
+// `lockAll` performs one atomic operation per texture instead of one per
+// reference, and both of our handles touch a single cache line per
+// resource.
@@ -0,0 +1,424 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+
+#include <chrono>
+#include <cstddef>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Composition is not always an option: large existing codebases are often
+// built around an inheritance hierarchy that cannot be rewritten overnight.
+
+// Let's go back to `InheritanceArkanoid` from the fourth code segment. Its
+// `Game` class stores `std::vector<std::unique_ptr<GameElement>>`, and
+// updating every element means:
+//
+// * Following a pointer to a separate heap allocation.
+//
+// * Calling a virtual function whose target depends on the dynamic type
+//   of the element. As types are mixed in arbitrary order, the CPU can't
+//   predict where the call will jump to.
+
+// In this code segment we'll write a "polymorphic collection": a container
+// that keeps elements of the same dynamic type together, by value, in one
+// contiguous "segment" per type. Elements are still accessed through the
+// `GameElement&` interface, but:
+//
+// * Iterating over a segment walks contiguous memory.
+//
+// * All elements of a segment have the same type, so the virtual call
+//   always jumps to the same target and is perfectly predicted.
+//
+// * When the types are known at compile-time, the segments can be
+//   iterated with their real type and the calls can be devirtualized.
+
+// ----------------------------------------------------------------
+
+namespace PolyArkanoid
+{
+    // We assign an unique ID to every element type, exactly like we did
+    // for component types in the previous code segments.
+    using SegmentID = std::size_t;
+
+    namespace Internal
+    {
+        inline SegmentID getUniqueSegmentID() noexcept
+        {
+            static SegmentID lastID{0u};
+            return lastID++;
+        }
+    }
+
+    template <typename T>
+    inline SegmentID getSegmentTypeID() noexcept
+    {
+        static SegmentID typeID{Internal::getUniqueSegmentID()};
+        return typeID;
+    }
+
+    template <typename TBase>
+    class PolyCollection
+    {
+    private:
+        // The type-erased part of a segment. Only two virtual calls are
+        // required per segment - not per element - to iterate over it.
+        struct SegmentBase
+        {
+            virtual ~SegmentBase() {}
+
+            // Pointer to the `TBase` subobject of the first element, or
+            // `nullptr` if the segment is empty.
+            virtual TBase* baseData() noexcept = 0;
+            virtual std::size_t size() const noexcept = 0;
+            virtual void clear() noexcept = 0;
+
+            // Distance in bytes between two consecutive elements.
+            std::size_t stride;
+
+            SegmentBase(std::size_t mStride) noexcept : stride{mStride} {}
+        };
+
+        template <typename T>
+        struct Segment : SegmentBase
+        {
+            std::vector<T> elements;
+
+            Segment() noexcept : SegmentBase{sizeof(T)} {}
+
+            TBase* baseData() noexcept override
+            {
+                return elements.empty() ? nullptr : &elements[0];
+            }
+
+            std::size_t size() const noexcept override
+            {
+                return elements.size();
+            }
+
+            void clear() noexcept override { elements.clear(); }
+        };
+
+        // Segments in creation order, used for iteration.
+        std::vector<std::unique_ptr<SegmentBase>> segments;
+
+        // Segments indexed by type ID, used for lookup. Types that have
+        // never been added to this collection have a `nullptr` entry.
+        std::vector<SegmentBase*> segmentsByID;
+
+        template <typename T>
+        Segment<T>* findSegment() const noexcept
+        {
+            auto id(getSegmentTypeID<T>());
+            return id < segmentsByID.size()
+                       ? static_cast<Segment<T>*>(segmentsByID[id])
+                       : nullptr;
+        }
+
+        template <typename T>
+        Segment<T>& getOrCreateSegment()
+        {
+            static_assert(std::is_base_of<TBase, T>{},
+                "`T` must derive from `TBase`");
+
+            auto s(findSegment<T>());
+            if(s != nullptr) return *s;
+
+            auto id(getSegmentTypeID<T>());
+            if(id >= segmentsByID.size()) segmentsByID.resize(id + 1, nullptr);
+
+            std::unique_ptr<Segment<T>> uPtr{new Segment<T>};
+            s = uPtr.get();
+
+            segments.emplace_back(std::move(uPtr));
+            segmentsByID[id] = s;
+
+            return *s;
+        }
+
+    public:
+        // Elements are stored by value: the returned reference is
+        // invalidated when more elements of the same type are added.
+        template <typename T, typename... TArgs>
+        T& emplace(TArgs&&... mArgs)
+        {
+            auto& elements(getOrCreateSegment<T>().elements);
+            elements.emplace_back(std::forward<TArgs>(mArgs)...);
+
+            return elements.back();
+        }
+
+        template <typename T>
+        void reserve(std::size_t mCount)
+        {
+            getOrCreateSegment<T>().elements.reserve(mCount);
+        }
+
+        std::size_t size() const noexcept
+        {
+            std::size_t result{0};
+            for(const auto& s : segments) result += s->size();
+
+            return result;
+        }
+
+        void clear() noexcept
+        {
+            for(auto& s : segments) s->clear();
+        }
+
+        // Calls `mFn(TBase&)` on every element, segment by segment.
+        template <typename TF>
+        void forEach(TF&& mFn)
+        {
+            for(auto& s : segments)
+            {
+                // The elements of a segment all have the same type, so
+                // their `TBase` subobjects are `stride` bytes apart.
+                auto data(reinterpret_cast<char*>(s->baseData()));
+                auto stride(s->stride);
+
+                for(std::size_t i{0}, n{s->size()}; i < n; ++i)
+                    mFn(*reinterpret_cast<TBase*>(data + i * stride));
+            }
+        }
+
+        // Calls `mFn(T&)` on every element of type `T`. The static type
+        // of the elements is known: calls to `final` overrides are not
+        // virtual anymore.
+        template <typename T, typename TF>
+        void forEachOf(TF&& mFn)
+        {
+            auto s(findSegment<T>());
+            if(s == nullptr) return;
+
+            for(auto& e : s->elements) mFn(e);
+        }
+    };
+}
+
+// ----------------------------------------------------------------
+
+// The `InheritanceArkanoid` hierarchy, with some data to work on. The
+// classes are marked `final`, which enables devirtualization in
+// `forEachOf`.
+
+namespace InheritanceArkanoid
+{
+    struct GameElement
+    {
+        virtual void update(float) {}
+        virtual void draw() {}
+        virtual ~GameElement() {}
+    };
+
+    struct Ball final : GameElement
+    {
+        float x{0.f}, y{0.f}, vx{1.f}, vy{1.f};
+
+        void update(float mFT) override
+        {
+            x += vx * mFT;
+            y += vy * mFT;
+        }
+
+        void draw() override { /* ... */}
+    };
+
+    struct Brick final : GameElement
+    {
+        float x{0.f}, y{0.f};
+        int hits{0};
+
+        void update(float) override { ++hits; }
+        void draw() override { /* ... */}
+    };
+
+    struct Paddle final : GameElement
+    {
+        float x{0.f}, vx{2.f};
+
+        void update(float mFT) override { x += vx * mFT; }
+        void draw() override { /* ... */}
+    };
+
+    struct Powerup final : GameElement
+    {
+        float y{0.f}, vy{0.5f};
+
+        void update(float mFT) override { y -= vy * mFT; }
+        void draw() override { /* ... */}
+    };
+
+    // The original game class.
+    struct Game
+    {
+        std::vector<std::unique_ptr<GameElement>> elements;
+
+        void update(float mFT)
+        {
+            for(auto& e : elements) e->update(mFT);
+        }
+
+        void draw()
+        {
+            for(auto& e : elements) e->draw();
+        }
+    };
+
+    // The same class, storing its elements in a `PolyCollection`. Its
+    // interface stays the same: adding a new element type doesn't require
+    // modifying it.
+    struct PolyGame
+    {
+        PolyArkanoid::PolyCollection<GameElement> elements;
+
+        void update(float mFT)
+        {
+            elements.forEach([mFT](GameElement& e)
+                {
+                    e.update(mFT);
+                });
+        }
+
+        void draw()
+        {
+            elements.forEach([](GameElement& e)
+                {
+                    e.draw();
+                });
+        }
+
+        // When the element types are known, every segment can be
+        // iterated with its real type.
+        template <typename... Ts>
+        void updateKnown(float mFT)
+        {
+            (void)std::initializer_list<int>{
+                (elements.forEachOf<Ts>([mFT](Ts& e)
+                     {
+                         e.update(mFT);
+                     }),
+                    0)...};
+        }
+    };
+}
+
+// ----------------------------------------------------------------
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* mTitle, TF&& mFn)
+{
+    auto start(HRClock::now());
+    auto result(mFn());
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+              << ")" << std::endl;
+}
+
+int main()
+{
+    using namespace InheritanceArkanoid;
+
+    constexpr std::size_t count{1000000};
+    constexpr std::size_t frames{100};
+
+    Game game;
+    PolyGame polyGame;
+
+    // Elements of random types are created in random order, as they
+    // would be during a real game.
+    std::minstd_rand rng{0};
+    std::uniform_int_distribution<int> typeDist{0, 3};
+
+    for(std::size_t i{0}; i < count; ++i)
+    {
+        switch(typeDist(rng))
+        {
+            case 0:
+                game.elements.emplace_back(new Ball);
+                polyGame.elements.emplace<Ball>();
+                break;
+            case 1:
+                game.elements.emplace_back(new Brick);
+                polyGame.elements.emplace<Brick>();
+                break;
+            case 2:
+                game.elements.emplace_back(new Paddle);
+                polyGame.elements.emplace<Paddle>();
+                break;
+            default:
+                game.elements.emplace_back(new Powerup);
+                polyGame.elements.emplace<Powerup>();
+                break;
+        }
+    }
+
+    // Prints "1000000".
+    std::cout << polyGame.elements.size() << std::endl;
+
+    std::cout << frames << " updates of " << count << " elements"
+              << std::endl;
+
+    // The returned values make sure the updates are not optimized away.
+    bench("std::vector<std::unique_ptr<GameElement>>", [&]
+        {
+            for(std::size_t f{0}; f < frames; ++f) game.update(1.f);
+
+            float sum{0.f};
+            for(auto& e : game.elements)
+                if(auto b = dynamic_cast<Ball*>(e.get())) sum += b->x;
+
+            return sum;
+        });
+
+    bench("PolyCollection, virtual calls", [&]
+        {
+            for(std::size_t f{0}; f < frames; ++f) polyGame.update(1.f);
+
+            float sum{0.f};
+            polyGame.elements.forEachOf<Ball>([&sum](Ball& b)
+                {
+                    sum += b.x;
+                });
+
+            return sum;
+        });
+
+    // Continues from the state left by the previous benchmark: the printed
+    // sum is twice as large.
+    bench("PolyCollection, devirtualized", [&]
+        {
+            for(std::size_t f{0}; f < frames; ++f)
+                polyGame.updateKnown<Ball, Brick, Paddle, Powerup>(1.f);
+
+            float sum{0.f};
+            polyGame.elements.forEachOf<Ball>([&sum](Ball& b)
+                {
+                    sum += b.x;
+                });
+
+            return sum;
+        });
+
+    polyGame.draw();
+    return 0;
+}
+
+// The order in which elements are updated changes: all the balls are
+// updated first, then all the bricks, and so on. Code that depends on the
+// update order of elements of different types can't use this container
+// as-is.
+
+// Elements are stored by value, so pointers and references to them are
+// invalidated when a segment grows: long-lived references to elements
+// require "handles".
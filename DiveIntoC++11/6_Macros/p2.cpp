@@ -0,0 +1,242 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// In the previous code segment, `VeryNaiveArkanoid::Game` had one
+// container and two hand-written loops for every game element type.
+// Adding a new type meant touching three different places.
+
+// It also stored every element through an `std::unique_ptr`: every element
+// lives in its own heap allocation, and iterating means following a
+// pointer for every single element.
+
+// In this code segment we'll generate the whole game class from a single
+// list of element types, using an "X-macro":
+//
+// * Every type is stored by value, in its own contiguous `std::vector`.
+//
+// * The `update` and `draw` loops are generated for every type.
+//
+// * Adding a new type requires adding a single line to the list.
+
+// ----------------------------------------------------------------
+
+// The game element classes, with some data to work on.
+
+struct Ball
+{
+    float x{0.f}, y{0.f}, vx{1.f}, vy{1.f};
+
+    void update(float mFT)
+    {
+        x += vx * mFT;
+        y += vy * mFT;
+    }
+
+    void draw() const { /* ... */}
+};
+
+struct Brick
+{
+    float x{0.f}, y{0.f};
+    int hits{0};
+
+    void update(float) { /* ... */}
+    void draw() const { /* ... */}
+};
+
+struct Paddle
+{
+    float x{0.f}, vx{2.f};
+
+    void update(float mFT) { x += vx * mFT; }
+    void draw() const { /* ... */}
+};
+
+struct Powerup
+{
+    float y{0.f}, vy{0.5f};
+
+    void update(float mFT) { y += vy * mFT; }
+    void draw() const { /* ... */}
+};
+
+// This is the only place where the element types are listed.
+// `X(type, name)` is "called" once per element type: every macro that
+// needs to do something for all types defines its own `X` and passes it
+// to `ARKANOID_ELEMENTS`.
+
+// Adding a new element type only requires a new line here.
+#define ARKANOID_ELEMENTS(X) \
+    X(Ball, balls)           \
+    X(Brick, bricks)         \
+    X(Paddle, paddles)       \
+    X(Powerup, powerups)
+
+// Tag type, used to select an overload by element type.
+template <typename T>
+struct Tag
+{
+};
+
+class Game
+{
+private:
+// One by-value container per element type.
+#define ARKANOID_STORAGE(mType, mName) std::vector<mType> mName;
+    ARKANOID_ELEMENTS(ARKANOID_STORAGE)
+#undef ARKANOID_STORAGE
+
+// One `storage` overload per element type, to access the containers
+// generically.
+#define ARKANOID_ACCESSOR(mType, mName)                          \
+    std::vector<mType>& storage(Tag<mType>) { return mName; }   \
+    const std::vector<mType>& storage(Tag<mType>) const         \
+    {                                                            \
+        return mName;                                            \
+    }
+    ARKANOID_ELEMENTS(ARKANOID_ACCESSOR)
+#undef ARKANOID_ACCESSOR
+
+public:
+    template <typename T>
+    std::vector<T>& get()
+    {
+        return storage(Tag<T>{});
+    }
+
+    template <typename T>
+    const std::vector<T>& get() const
+    {
+        return storage(Tag<T>{});
+    }
+
+    template <typename T, typename... TArgs>
+    T& create(TArgs&&... mArgs)
+    {
+        auto& v(get<T>());
+        v.emplace_back(std::forward<TArgs>(mArgs)...);
+
+        return v.back();
+    }
+
+    // Iterating over contiguous elements: no pointer to follow.
+    void update(float mFT)
+    {
+#define ARKANOID_UPDATE(mType, mName) \
+    for(auto& e : mName) e.update(mFT);
+        ARKANOID_ELEMENTS(ARKANOID_UPDATE)
+#undef ARKANOID_UPDATE
+    }
+
+    void draw() const
+    {
+#define ARKANOID_DRAW(mType, mName) \
+    for(const auto& e : mName) e.draw();
+        ARKANOID_ELEMENTS(ARKANOID_DRAW)
+#undef ARKANOID_DRAW
+    }
+
+    std::size_t size() const
+    {
+        std::size_t result{0};
+
+#define ARKANOID_SIZE(mType, mName) result += mName.size();
+        ARKANOID_ELEMENTS(ARKANOID_SIZE)
+#undef ARKANOID_SIZE
+
+        return result;
+    }
+};
+
+// ----------------------------------------------------------------
+
+// `VeryNaiveArkanoid::Game` from the previous code segment, for
+// comparison.
+struct NaiveGame
+{
+    std::vector<std::unique_ptr<Ball>> balls;
+    std::vector<std::unique_ptr<Brick>> bricks;
+    std::vector<std::unique_ptr<Paddle>> paddles;
+    std::vector<std::unique_ptr<Powerup>> powerups;
+
+    void update(float mFT)
+    {
+        for(auto& b : balls) b->update(mFT);
+        for(auto& b : bricks) b->update(mFT);
+        for(auto& p : paddles) p->update(mFT);
+        for(auto& p : powerups) p->update(mFT);
+    }
+};
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* mTitle, TF&& mFn)
+{
+    auto start(HRClock::now());
+    auto result(mFn());
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+              << ")" << std::endl;
+}
+
+int main()
+{
+    constexpr std::size_t count{100000};
+    constexpr std::size_t frames{1000};
+
+    Game game;
+    NaiveGame naiveGame;
+
+    // Elements are created interleaved, as they would be during a real
+    // game: the naive version's heap allocations end up scattered.
+    for(std::size_t i{0}; i < count; ++i)
+    {
+        game.create<Ball>();
+        game.create<Brick>();
+        game.create<Powerup>();
+
+        naiveGame.balls.emplace_back(new Ball);
+        naiveGame.bricks.emplace_back(new Brick);
+        naiveGame.powerups.emplace_back(new Powerup);
+    }
+
+    game.create<Paddle>();
+    naiveGame.paddles.emplace_back(new Paddle);
+
+    // Prints "300001".
+    std::cout << game.size() << std::endl;
+
+    std::cout << frames << " updates of " << game.size() << " elements"
+              << std::endl;
+
+    bench("std::vector<std::unique_ptr<T>>", [&]
+        {
+            for(std::size_t f{0}; f < frames; ++f) naiveGame.update(1.f);
+            return naiveGame.balls.back()->x;
+        });
+
+    bench("X-macro generated `Game`", [&]
+        {
+            for(std::size_t f{0}; f < frames; ++f) game.update(1.f);
+            game.draw();
+
+            return game.get<Ball>().back().x;
+        });
+
+    return 0;
+}
+
+// Storing elements by value has a trade-off: references to elements are
+// invalidated when their container grows. Elements that need to be
+// referred to for a long time require "handles" instead of pointers.
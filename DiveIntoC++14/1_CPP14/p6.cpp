@@ -0,0 +1,241 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+
+namespace CPP14LanguageFeatures
+{
+    // Variable templates + relaxed `constexpr` functions.
+    //
+    //    * C++14 `constexpr` functions can contain loops and mutate
+    //      local variables.
+    //
+    //    * Combined with variable templates, they allow us to generate
+    //      whole lookup tables at compile-time: the tables are stored
+    //      in read-only memory, and no initialization code runs at
+    //      startup.
+    //
+
+    template <typename T>
+    constexpr T pi{3.14159265358979323846};
+
+    // A plain array wrapper: `std::array`'s non-const `operator[]` is not
+    // `constexpr` in C++14.
+    template <typename T, std::size_t TN>
+    struct Table
+    {
+        T data[TN];
+
+        constexpr const T& operator[](std::size_t mI) const noexcept
+        {
+            return data[mI];
+        }
+    };
+
+    // ----------------------------------------------------------------
+
+    // `std::sin` is not `constexpr`: the table is generated with our own
+    // implementation. It doesn't need to be fast, only accurate.
+
+    // Taylor series of `sin(x)`, for `x` in `[-pi, pi]`.
+    template <typename T>
+    constexpr T ctSin(T mX) noexcept
+    {
+        // The series is evaluated in `long double` for extra accuracy.
+        long double x(mX), term(x), result(x);
+
+        for(int i(1); i < 30; ++i)
+        {
+            term *= -x * x / ((2 * i) * (2 * i + 1));
+            result += term;
+        }
+
+        return static_cast<T>(result);
+    }
+
+    // `sinTable<T, TN>` stores `TN + 1` samples of `sin` over `[0, 2pi]`.
+    // The extra sample allows interpolating the last interval without
+    // wrapping around.
+    template <typename T, std::size_t TN>
+    constexpr auto makeSinTable() noexcept
+    {
+        Table<T, TN + 1> result{};
+
+        for(std::size_t i(0); i <= TN; ++i)
+        {
+            // Reduce to `[-pi, pi]`, where the series converges quickly.
+            long double x(2 * pi<long double> * i / TN);
+            if(x > pi<long double>) x -= 2 * pi<long double>;
+
+            result.data[i] = ctSin<T>(static_cast<T>(x));
+        }
+
+        return result;
+    }
+
+    template <typename T, std::size_t TN>
+    constexpr auto sinTable(makeSinTable<T, TN>());
+
+    // The tables really are compile-time constants.
+    static_assert(sinTable<float, 4096>[0] == 0.f, "");
+    static_assert(sinTable<double, 4>[1] > 0.999999999 &&
+                      sinTable<double, 4>[1] < 1.000000001,
+        "");
+
+    // ----------------------------------------------------------------
+
+    // Lookup functions, with linear interpolation between samples.
+    // `TN` must be a power of two, so that wrapping around is a mask.
+
+    // Interpolates `sinTable<T, TN>` at `mPos`, measured in samples.
+    template <typename T, std::size_t TN>
+    T sampleSinTable(T mPos) noexcept
+    {
+        static_assert((TN & (TN - 1)) == 0, "`TN` must be a power of two");
+
+        // `std::floor` keeps negative angles correct.
+        T base(std::floor(mPos));
+        T t(mPos - base);
+
+        auto i(static_cast<std::size_t>(static_cast<std::int64_t>(base)) &
+               (TN - 1));
+
+        const auto& table(sinTable<T, TN>);
+        return table[i] + (table[i + 1] - table[i]) * t;
+    }
+
+    template <typename T, std::size_t TN = 4096>
+    T tableSin(T mX) noexcept
+    {
+        constexpr T scale(TN / (2 * pi<T>));
+        return sampleSinTable<T, TN>(mX * scale);
+    }
+
+    // `cos(x) = sin(x + pi/2)`: the quarter period is added in samples,
+    // where it is exact, instead of radians.
+    template <typename T, std::size_t TN = 4096>
+    T tableCos(T mX) noexcept
+    {
+        constexpr T scale(TN / (2 * pi<T>));
+        return sampleSinTable<T, TN>(mX * scale + TN / 4);
+    }
+
+    // ----------------------------------------------------------------
+
+    // Accuracy tests against the standard library.
+
+    template <typename TF, typename TRef>
+    double maxError(float mMin, float mMax, TF&& mFn, TRef&& mRef)
+    {
+        double result(0);
+
+        for(int i(0); i <= 1000000; ++i)
+        {
+            float x(mMin + (mMax - mMin) * (i / 1000000.f));
+            double error(std::abs(double(mFn(x)) - double(mRef(x))));
+
+            if(error > result) result = error;
+        }
+
+        return result;
+    }
+
+    void testAccuracy()
+    {
+        // Large `float` angles lose precision before the lookup even starts:
+        // the tests cover a few periods around zero.
+        auto sinError(maxError(-10.f, 10.f,
+            [](float x)
+            {
+                return tableSin(x);
+            },
+            [](float x)
+            {
+                return std::sin(double(x));
+            }));
+
+        auto cosError(maxError(-10.f, 10.f,
+            [](float x)
+            {
+                return tableCos(x);
+            },
+            [](float x)
+            {
+                return std::cos(double(x));
+            }));
+
+        std::cout << "max sin error: " << sinError << "\n"
+                  << "max cos error: " << cosError << "\n";
+
+        // With 4096 samples, linear interpolation alone is accurate to
+        // about `(2pi / 4096)^2 / 8`, roughly `3e-7`: the rest is `float`
+        // rounding.
+        assert(sinError < 2e-6);
+        assert(cosError < 2e-6);
+    }
+
+    // ----------------------------------------------------------------
+
+    using HRClock = std::chrono::high_resolution_clock;
+
+    template <typename TF>
+    void bench(const char* mTitle, TF&& mFn)
+    {
+        auto start(HRClock::now());
+        auto result(mFn());
+        auto end(HRClock::now());
+
+        auto ms(
+            std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+        std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+                  << ")\n";
+    }
+
+    void benchmark(int mN)
+    {
+        std::cout << mN << " evaluations\n";
+
+        bench("std::sin", [mN]
+            {
+                double sum(0);
+                for(int i(0); i < mN; ++i) sum += std::sin(i * 0.001f);
+
+                return sum;
+            });
+
+        bench("tableSin", [mN]
+            {
+                double sum(0);
+                for(int i(0); i < mN; ++i) sum += tableSin(i * 0.001f);
+
+                return sum;
+            });
+    }
+}
+
+int main()
+{
+    using namespace CPP14LanguageFeatures;
+
+    testAccuracy();
+    benchmark(100000000);
+
+    return 0;
+}
+
+// Tables trade accuracy and cache space for speed: measure on the target
+// hardware before replacing calls to the standard library.
+
+// Not every function is worth a table. `1 / std::sqrt` compiles to two
+// pipelined hardware instructions: a reciprocal square root table, which
+// has to split the exponent from the mantissa and refine the result with
+// a Newton-Raphson step to be as accurate, was measured slower than that
+// on x86-64, and was left out.
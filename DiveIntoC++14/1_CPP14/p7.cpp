@@ -0,0 +1,342 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace CPP14LanguageFeatures
+{
+    // In the `decltype(auto)` code segment we saw that small changes in a
+    // `return` statement can change what a function returns - and that
+    // `return std::move(local)` prevents the compiler from eliding the
+    // move.
+    //
+    // Mistakes like that are hard to spot during review: the code
+    // compiles, works, and is "only" slower. In this code segment we'll
+    // write an "instrumented" type that counts its own constructions,
+    // copies, moves and destructions, and a small helper that checks the
+    // exact counts of any piece of code.
+
+    // ----------------------------------------------------------------
+
+    struct LifetimeCounts
+    {
+        std::size_t constructions{0};
+        std::size_t copies{0};
+        std::size_t moves{0};
+        std::size_t copyAssignments{0};
+        std::size_t moveAssignments{0};
+        std::size_t destructions{0};
+
+        // "Named parameter" setters, to write expectations readably:
+        // `LifetimeCounts{}.constructed(1).moved(1).destroyed(2)`.
+        auto& constructed(std::size_t mX)
+        {
+            constructions = mX;
+            return *this;
+        }
+        auto& copied(std::size_t mX)
+        {
+            copies = mX;
+            return *this;
+        }
+        auto& moved(std::size_t mX)
+        {
+            moves = mX;
+            return *this;
+        }
+        auto& copyAssigned(std::size_t mX)
+        {
+            copyAssignments = mX;
+            return *this;
+        }
+        auto& moveAssigned(std::size_t mX)
+        {
+            moveAssignments = mX;
+            return *this;
+        }
+        auto& destroyed(std::size_t mX)
+        {
+            destructions = mX;
+            return *this;
+        }
+
+        // Objects that were created but never destroyed.
+        auto alive() const noexcept
+        {
+            return constructions + copies + moves - destructions;
+        }
+
+        bool operator==(const LifetimeCounts& mX) const noexcept
+        {
+            return constructions == mX.constructions && copies == mX.copies &&
+                   moves == mX.moves &&
+                   copyAssignments == mX.copyAssignments &&
+                   moveAssignments == mX.moveAssignments &&
+                   destructions == mX.destructions;
+        }
+    };
+
+    std::ostream& operator<<(std::ostream& mS, const LifetimeCounts& mX)
+    {
+        return mS << "{constructions: " << mX.constructions
+                  << ", copies: " << mX.copies << ", moves: " << mX.moves
+                  << ", copy assignments: " << mX.copyAssignments
+                  << ", move assignments: " << mX.moveAssignments
+                  << ", destructions: " << mX.destructions << "}";
+    }
+
+    // Every `TTag` gets its own counters: different instrumented types can
+    // be used in the same test without interfering with each other.
+    template <typename TTag = void>
+    struct Instrumented
+    {
+        int value;
+
+        // A variable template would be nice here, but static data members
+        // of class templates can't be declared `inline` in C++14.
+        static auto& counts() noexcept
+        {
+            static LifetimeCounts result;
+            return result;
+        }
+
+        Instrumented(int mValue = 0) noexcept : value{mValue}
+        {
+            ++counts().constructions;
+        }
+
+        Instrumented(const Instrumented& mX) noexcept : value{mX.value}
+        {
+            ++counts().copies;
+        }
+
+        // Move operations are `noexcept`, like in any well-behaved type:
+        // otherwise `std::vector` would copy elements when it grows.
+        Instrumented(Instrumented&& mX) noexcept : value{mX.value}
+        {
+            ++counts().moves;
+        }
+
+        Instrumented& operator=(const Instrumented& mX) noexcept
+        {
+            value = mX.value;
+            ++counts().copyAssignments;
+            return *this;
+        }
+
+        Instrumented& operator=(Instrumented&& mX) noexcept
+        {
+            value = mX.value;
+            ++counts().moveAssignments;
+            return *this;
+        }
+
+        ~Instrumented() { ++counts().destructions; }
+    };
+
+    // Runs `mFn` and compares the counts of `Instrumented<TTag>` with
+    // `mExpected`. Also reports objects that were leaked by `mFn`.
+    // Returns `true` on success.
+    template <typename TTag = void, typename TF>
+    bool checkLifetime(
+        const char* mTitle, const LifetimeCounts& mExpected, TF&& mFn)
+    {
+        auto& counts(Instrumented<TTag>::counts());
+        counts = LifetimeCounts{};
+
+        mFn();
+
+        bool ok(counts == mExpected && counts.alive() == 0);
+        std::cout << (ok ? "  OK   " : "  FAIL ") << mTitle << "\n";
+
+        if(!ok)
+        {
+            std::cout << "       expected: " << mExpected << "\n"
+                      << "       actual:   " << counts << "\n";
+        }
+
+        return ok;
+    }
+
+    // ----------------------------------------------------------------
+
+    // Let's audit the functions from the `decltype(auto)` code segment,
+    // using `Instrumented<>` instead of `std::string`.
+
+    using I = Instrumented<>;
+
+    auto returnLocal()
+    {
+        I x{1};
+        return x;
+    }
+
+    auto returnMovedLocal()
+    {
+        I x{1};
+
+        // Same mistake as `func5`: `std::move` turns the returned
+        // expression into something that is not the name of a local
+        // object, so the move can't be elided anymore. Recent compilers
+        // warn about this with `-Wpessimizing-move`.
+        return std::move(x);
+    }
+
+    auto returnStaticByValue()
+    {
+        static I x{1};
+
+        auto& result(x);
+        return result;
+    }
+
+    decltype(auto) returnStaticByRef()
+    {
+        static I x{1};
+
+        auto& result(x);
+        return result;
+    }
+
+    // A "sink" function, that stores its argument.
+    struct Holder
+    {
+        I item;
+
+        void setByConstRef(const I& mX) { item = mX; }
+        void setByValue(I mX) { item = std::move(mX); }
+    };
+
+    // `make_vector` from the `forArgs` tutorial.
+    template <typename TF, typename... Ts>
+    void forArgs(TF&& mFn, Ts&&... mArgs)
+    {
+        return (void)std::initializer_list<int>{
+            (mFn(std::forward<Ts>(mArgs)), 0)...};
+    }
+
+    template <typename... TArgs>
+    auto make_vector(TArgs&&... mArgs)
+    {
+        using VectorItem = std::common_type_t<TArgs...>;
+        std::vector<VectorItem> result;
+
+        result.reserve(sizeof...(TArgs));
+        forArgs(
+            [&result](auto&& x)
+            {
+                result.emplace_back(std::forward<decltype(x)>(x));
+            },
+            std::forward<TArgs>(mArgs)...);
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------
+
+    bool audit()
+    {
+        bool ok(true);
+
+        // The static objects below are created once, outside of the
+        // checks.
+        returnStaticByValue();
+        returnStaticByRef();
+
+        // Copy elision: a single object is ever created.
+        ok &= checkLifetime("return local",
+            LifetimeCounts{}.constructed(1).destroyed(1), []
+            {
+                auto x(returnLocal());
+                (void)x;
+            });
+
+        // One extra move, and one extra destruction.
+        ok &= checkLifetime("return std::move(local)",
+            LifetimeCounts{}.constructed(1).moved(1).destroyed(2), []
+            {
+                auto x(returnMovedLocal());
+                (void)x;
+            });
+
+        // `auto` always returns by value: a copy of the static object.
+        ok &= checkLifetime("auto return of a reference",
+            LifetimeCounts{}.copied(1).destroyed(1), []
+            {
+                returnStaticByValue();
+            });
+
+        // `decltype(auto)` preserves the reference: nothing happens.
+        ok &= checkLifetime("decltype(auto) return of a reference",
+            LifetimeCounts{}, []
+            {
+                auto& x(returnStaticByRef());
+                (void)x;
+            });
+
+        // Passing an rvalue by value and moving it into place: one move
+        // assignment, and no copies.
+        ok &= checkLifetime("sink by value, rvalue argument",
+            LifetimeCounts{}.constructed(2).moveAssigned(1).destroyed(2), []
+            {
+                Holder h;
+                h.setByValue(I{2});
+            });
+
+        // Taking `const&` forces a copy, even for temporaries.
+        ok &= checkLifetime("sink by const&, rvalue argument",
+            LifetimeCounts{}.constructed(2).copyAssigned(1).destroyed(2), []
+            {
+                Holder h;
+                h.setByConstRef(I{2});
+            });
+
+        // `make_vector` forwards perfectly: lvalues are copied, rvalues
+        // are moved, and the vector is never reallocated thanks to
+        // `reserve`.
+        ok &= checkLifetime("make_vector(lvalue, rvalue, temporary)",
+            LifetimeCounts{}.constructed(3).copied(1).moved(2).destroyed(6),
+            []
+            {
+                I a{1}, b{2};
+                auto v(make_vector(a, std::move(b), I{3}));
+                (void)v;
+            });
+
+        return ok;
+    }
+}
+
+int main()
+{
+    using namespace CPP14LanguageFeatures;
+
+    // A non-zero exit code makes the audit usable as an automated test.
+    return audit() ? 0 : 1;
+}
+
+// `Instrumented<TTag>` and `checkLifetime` only depend on the standard
+// library: they can be copied into any other code segment to audit the
+// copies and moves performed by its functions and containers.
+
+// They are copied into two other code segments, to audit real code:
+//
+// * `Handles/p5.cpp` counts the lifetime of the entities stored in a
+//   `Manager`: they are constructed in place, relocated without calling
+//   their move constructor, and destroyed exactly once.
+//
+// * `DiveIntoC++14/3_UniqueResource/p9.cpp` counts the acquisitions and
+//   releases of `resource::unique` and `pending_unique`, including
+//   cancelled asynchronous acquisitions.
+
+// Keep in mind that copy elision of named local objects (NRVO) is allowed
+// but not required by C++14: the expected counts above assume a compiler
+// that performs it, as all major compilers do when optimizations are
+// enabled - and usually even when they aren't.
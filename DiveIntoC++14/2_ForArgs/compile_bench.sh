@@ -0,0 +1,65 @@
+#!/bin/bash
+# Compiles `p14.cpp` once per variant and argument count, and prints the
+# compiler's wall time and peak memory usage.
+#
+# Usage: ./compile_bench.sh [argument counts...]   (default: 10 100 1000)
+#
+# Set `CXX` to choose the compiler and `CXXFLAGS` to pass extra flags.
+# Compilations taking longer than `LIMIT` seconds (default: 120) are
+# stopped and reported as such.
+# Peak memory requires GNU `time` at `/usr/bin/time`.
+
+CXX=${CXX:-clang++}
+COUNTS=${@:-10 100 1000}
+LIMIT=${LIMIT:-120}
+
+NAMES=(
+    "forArgs (initializer_list)"
+    "forArgs (fold expression)"
+    "forArgs (recursive)"
+    "forNArgs<2> (index sequences)"
+    "forNArgs<2> (recursive)"
+    "make_unordered_map (tuple_element_t)"
+    "make_unordered_map (flat TypeAt)"
+)
+
+OUT=$(mktemp)
+trap 'rm -f "$OUT" "$OUT.time"' EXIT
+
+printf "%-40s %6s %10s %12s\n" "variant" "args" "time (s)" "memory (KB)"
+
+for v in "${!NAMES[@]}"; do
+    # Fold expressions require C++17.
+    STD=c++14
+    [ "$v" -eq 1 ] && STD=c++1z
+
+    for n in $COUNTS; do
+        ARGS=$(seq -s, 0 $((n - 1)))
+        CMD=("$CXX" -std=$STD -ftemplate-depth=4096 $CXXFLAGS
+            -DBENCH_VARIANT=$v "-DBENCH_ARGS=$ARGS" ./p14.cpp -o "$OUT")
+
+        if [ -x /usr/bin/time ]; then
+            timeout "$LIMIT" /usr/bin/time -f "%e %M" -o "$OUT.time" \
+                "${CMD[@]}" 2>/dev/null
+            STATUS=$?
+            read -r ELAPSED MEMORY < "$OUT.time"
+        else
+            TIMEFORMAT=%R
+            { time timeout "$LIMIT" "${CMD[@]}" 2>/dev/null; } 2> "$OUT.time"
+            STATUS=$?
+            read -r ELAPSED < "$OUT.time"
+            MEMORY="-"
+        fi
+
+        if [ $STATUS -eq 124 ]; then
+            ELAPSED=">$LIMIT"
+            MEMORY="-"
+        elif [ $STATUS -ne 0 ]; then
+            ELAPSED="failed"
+            MEMORY="-"
+        fi
+
+        printf "%-40s %6s %10s %12s\n" "${NAMES[$v]}" "$n" "$ELAPSED" \
+            "$MEMORY"
+    done
+done
@@ -0,0 +1,527 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// `make_unordered_map` builds its map at run-time: every entry is a heap
+// allocated node, and every key is hashed at startup - even when all the keys
+// are literals known at compile-time.
+
+// Thanks to C++14's relaxed `constexpr` rules, we can build the whole table
+// at compile-time instead. In this code segment we'll implement
+// `make_static_map(k0, v0, k1, v1, ...)`: it deduces key and value types
+// exactly like `make_unordered_map`, but returns a `constexpr` perfect hash
+// table that lives in read-only memory.
+
+// ----------------------------------------------------------------
+
+// Same `CommonKVHelper` we've seen in the previous code segments.
+
+template <typename TSeq, typename... Ts>
+struct CommonKVHelper;
+
+template <std::size_t... TIs, typename... Ts>
+struct CommonKVHelper<std::index_sequence<TIs...>, Ts...>
+{
+    static_assert(sizeof...(Ts) % 2 == 0, "");
+
+    template <std::size_t TI>
+    using TypeAt = std::tuple_element_t<TI, std::tuple<Ts...>>;
+
+    using KeyType = std::common_type_t<TypeAt<TIs * 2>...>;
+    using ValueType = std::common_type_t<TypeAt<(TIs * 2) + 1>...>;
+};
+
+template <typename... Ts>
+using HelperFor =
+    CommonKVHelper<std::make_index_sequence<sizeof...(Ts) / 2>, Ts...>;
+
+template <typename... Ts>
+using CommonKeyType = typename HelperFor<Ts...>::KeyType;
+
+template <typename... Ts>
+using CommonValueType = typename HelperFor<Ts...>::ValueType;
+
+// ----------------------------------------------------------------
+
+// Key hashing and comparison. String literals decay to `const char*`: we
+// hash and compare them by contents, not by address.
+
+// All arithmetic is done on unsigned 64-bit integers, whose overflow is
+// well-defined - and therefore allowed during constant evaluation.
+
+constexpr std::uint64_t mix(std::uint64_t mX) noexcept
+{
+    mX ^= mX >> 33;
+    mX *= 0xff51afd7ed558ccdull;
+    mX ^= mX >> 33;
+    mX *= 0xc4ceb9fe1a85ec53ull;
+    mX ^= mX >> 33;
+    return mX;
+}
+
+// Integral and enumeration keys are their own hash bits. Floating-point
+// keys are not supported: converting them would truncate distinct keys
+// like `1.5` and `1.7` to the same bits, and C++14 has no `constexpr` way
+// of reading their bit pattern.
+template <typename T>
+constexpr std::uint64_t keyBits(const T& mKey) noexcept
+{
+    return static_cast<std::uint64_t>(mKey);
+}
+
+template <typename T>
+using IsStaticMapKey =
+    std::integral_constant<bool, std::is_integral<T>{} || std::is_enum<T>{} ||
+                                     std::is_same<T, const char*>{}>;
+
+// FNV-1a string hash.
+constexpr std::uint64_t keyBits(const char* mKey) noexcept
+{
+    std::uint64_t result{0xcbf29ce484222325ull};
+
+    for(; *mKey != '\0'; ++mKey)
+    {
+        result ^= static_cast<unsigned char>(*mKey);
+        result *= 0x100000001b3ull;
+    }
+
+    return result;
+}
+
+template <typename T>
+constexpr bool keyEqual(const T& mA, const T& mB) noexcept
+{
+    return mA == mB;
+}
+
+constexpr bool keyEqual(const char* mA, const char* mB) noexcept
+{
+    while(*mA != '\0' && *mA == *mB)
+    {
+        ++mA;
+        ++mB;
+    }
+
+    return *mA == *mB;
+}
+
+constexpr std::size_t nextPowerOfTwo(std::size_t mX) noexcept
+{
+    std::size_t result{1};
+    while(result < mX) result *= 2;
+    return result;
+}
+
+template <typename TK, typename TV>
+struct StaticMapEntry
+{
+    TK key;
+    TV value;
+};
+
+// `StaticMap` uses a "hash and displace" perfect hashing scheme, computed at
+// compile-time:
+//
+// * Keys are first distributed among a small number of buckets.
+//
+// * For every bucket, the constructor searches for a "displacement" value
+//   that sends all of the bucket's keys to free slots of the final table.
+//
+// A lookup is then always a bucket load, a slot load and a single key
+// comparison - no probing, no chaining, no heap.
+
+template <typename TK, typename TV, std::size_t TN>
+class StaticMap
+{
+private:
+    static_assert(IsStaticMapKey<TK>{},
+        "StaticMap keys must be integers, enums or string literals");
+
+    using Entry = StaticMapEntry<TK, TV>;
+
+    // Keeping the table at most half full makes displacements quick to find.
+    // Needing more than `maxDisplacement` attempts for a bucket means that
+    // its keys can't be separated.
+    static constexpr std::uint64_t maxDisplacement{1 << 16};
+    static constexpr std::size_t slotCount{nextPowerOfTwo(TN * 2)};
+    static constexpr std::size_t bucketCount{nextPowerOfTwo(TN / 2 + 1)};
+
+    // Marks an empty slot.
+    static constexpr std::size_t emptySlot{TN};
+
+    // `std::array`'s non-const `operator[]` is not `constexpr` in C++14,
+    // so we use plain arrays.
+    Entry entries[TN];
+    std::uint64_t displacements[bucketCount];
+    std::size_t slots[slotCount];
+
+    static constexpr auto bucketOf(std::uint64_t mBits) noexcept
+    {
+        return static_cast<std::size_t>(mix(mBits) & (bucketCount - 1));
+    }
+
+    static constexpr auto slotOf(
+        std::uint64_t mBits, std::uint64_t mDisplacement) noexcept
+    {
+        return static_cast<std::size_t>(
+            mix(mBits ^ (mDisplacement * 0x9e3779b97f4a7c15ull)) &
+            (slotCount - 1));
+    }
+
+    // Tries to place the `mCount` keys whose indices are in `mKeys` using
+    // displacement `mD`. The slots are claimed as we go, and given back if
+    // one of the keys collides.
+    constexpr bool tryPlace(const std::size_t* mKeys, std::size_t mCount,
+        const std::uint64_t* mBits, std::uint64_t mD)
+    {
+        for(std::size_t k(0); k < mCount; ++k)
+        {
+            auto s(slotOf(mBits[mKeys[k]], mD));
+
+            if(slots[s] != emptySlot)
+            {
+                for(std::size_t u(0); u < k; ++u)
+                    slots[slotOf(mBits[mKeys[u]], mD)] = emptySlot;
+
+                return false;
+            }
+
+            slots[s] = mKeys[k];
+        }
+
+        return true;
+    }
+
+    // Every key is hashed once, and the keys of each bucket are listed
+    // once: a placement attempt only looks at the keys of its bucket. The
+    // whole construction is roughly linear in `TN`, which matters during
+    // constant evaluation - it is much slower than running the same code.
+    constexpr void build()
+    {
+        std::uint64_t bits[TN]{};
+        for(std::size_t i(0); i < TN; ++i) bits[i] = keyBits(entries[i].key);
+
+        // Counting sort of the key indices by bucket: the keys of bucket
+        // `b` are `bucketKeys[bucketBegin[b]]...bucketKeys[bucketBegin[b +
+        // 1] - 1]`.
+        std::size_t bucketBegin[bucketCount + 1]{};
+        for(std::size_t i(0); i < TN; ++i) ++bucketBegin[bucketOf(bits[i]) + 1];
+
+        for(std::size_t b(0); b < bucketCount; ++b)
+            bucketBegin[b + 1] += bucketBegin[b];
+
+        std::size_t bucketKeys[TN]{};
+        std::size_t bucketFill[bucketCount]{};
+        for(std::size_t i(0); i < TN; ++i)
+        {
+            auto b(bucketOf(bits[i]));
+            bucketKeys[bucketBegin[b] + bucketFill[b]++] = i;
+        }
+
+        // Equal keys have equal hashes, and therefore end up in the same
+        // bucket: only keys of the same bucket with the same hash need to
+        // be compared. Distinct keys with the same hash (FNV-1a
+        // collisions) always land in the same slot, and can't be placed
+        // either.
+        // Throwing during constant evaluation is a compilation error.
+        for(std::size_t b(0); b < bucketCount; ++b)
+            for(auto i(bucketBegin[b]); i < bucketBegin[b + 1]; ++i)
+                for(auto j(i + 1); j < bucketBegin[b + 1]; ++j)
+                {
+                    auto kI(bucketKeys[i]), kJ(bucketKeys[j]);
+                    if(bits[kI] != bits[kJ]) continue;
+
+                    if(keyEqual(entries[kI].key, entries[kJ].key))
+                        throw std::logic_error{"duplicate key in StaticMap"};
+
+                    throw std::logic_error{"colliding keys in StaticMap"};
+                }
+
+        for(auto& s : slots) s = emptySlot;
+
+        // Buckets are placed from the biggest to the smallest, as the
+        // biggest ones are the hardest to fit. They are ordered with
+        // another counting sort, by decreasing size.
+        std::size_t sizeBegin[TN + 2]{};
+        for(std::size_t b(0); b < bucketCount; ++b)
+            ++sizeBegin[TN - bucketFill[b] + 1];
+
+        for(std::size_t n(0); n <= TN; ++n) sizeBegin[n + 1] += sizeBegin[n];
+
+        std::size_t order[bucketCount]{};
+        for(std::size_t b(0); b < bucketCount; ++b)
+            order[sizeBegin[TN - bucketFill[b]]++] = b;
+
+        for(auto b : order)
+        {
+            if(bucketFill[b] == 0) break;
+
+            std::uint64_t d{1};
+            while(!tryPlace(&bucketKeys[bucketBegin[b]], bucketFill[b], bits, d))
+                if(++d > maxDisplacement)
+                    throw std::logic_error{"cannot place StaticMap keys"};
+
+            displacements[b] = d;
+        }
+    }
+
+public:
+    template <typename... TEntries>
+    constexpr StaticMap(TEntries... mEntries)
+        : entries{mEntries...}, displacements{}, slots{}
+    {
+        build();
+    }
+
+    constexpr auto size() const noexcept
+    {
+        return TN;
+    }
+
+    // Returns a pointer to the value mapped to `mKey`, or `nullptr`.
+    constexpr const TV* find(const TK& mKey) const noexcept
+    {
+        auto bits(keyBits(mKey));
+        auto i(slots[slotOf(bits, displacements[bucketOf(bits)])]);
+
+        return i != emptySlot && keyEqual(entries[i].key, mKey)
+                   ? &entries[i].value
+                   : nullptr;
+    }
+
+    constexpr bool contains(const TK& mKey) const noexcept
+    {
+        return find(mKey) != nullptr;
+    }
+
+    constexpr const TV& at(const TK& mKey) const
+    {
+        auto result(find(mKey));
+        if(result == nullptr) throw std::out_of_range{"key not found"};
+
+        return *result;
+    }
+};
+
+template <typename TK, typename TV, typename TTpl, std::size_t... TIs>
+constexpr auto makeStaticMapImpl(TTpl&& mTpl, std::index_sequence<TIs...>)
+{
+    using Entry = StaticMapEntry<TK, TV>;
+
+    return StaticMap<TK, TV, sizeof...(TIs)>{
+        Entry{static_cast<TK>(std::get<TIs * 2>(mTpl)),
+            static_cast<TV>(std::get<(TIs * 2) + 1>(mTpl))}...};
+}
+
+// `forNArgs` cannot be used in a `constexpr` function (lambdas are not
+// `constexpr` in C++14), but the idea is the same: we split the forwarded
+// arguments into key-value pairs with an index sequence.
+template <typename... TArgs>
+constexpr auto make_static_map(TArgs&&... mArgs)
+{
+    static_assert(sizeof...(TArgs) > 0, "");
+
+    using KeyType = CommonKeyType<TArgs...>;
+    using ValueType = CommonValueType<TArgs...>;
+
+    return makeStaticMapImpl<KeyType, ValueType>(
+        std::forward_as_tuple(std::forward<TArgs>(mArgs)...),
+        std::make_index_sequence<sizeof...(TArgs) / 2>{});
+}
+
+// ----------------------------------------------------------------
+
+// An opcode table, built entirely at compile-time.
+constexpr auto opcodes(make_static_map(
+    "mov", 0, "add", 1, "sub", 2, "mul", 3, "div", 4, "jmp", 5, "cmp", 6,
+    "ret", 7, "call", 8, "push", 9, "pop", 10, "and", 11, "or", 12, "xor", 13,
+    "not", 14, "nop", 15));
+
+static_assert(opcodes.size() == 16, "");
+static_assert(opcodes.at("mov") == 0, "");
+static_assert(opcodes.at("nop") == 15, "");
+static_assert(opcodes.at("call") == 8, "");
+static_assert(!opcodes.contains("halt"), "");
+
+// Integer keys work as well. The value type is deduced as `double`.
+constexpr auto scales(make_static_map(10, 1.f, 20, 2.0, 5, 0.5f));
+static_assert(scales.at(5) == 0.5, "");
+static_assert(scales.at(20) == 2.0, "");
+
+// A sparse numeric dispatch table.
+constexpr auto handlers(make_static_map(0x10, 0, 0x22, 1, 0x31, 2, 0x4f, 3,
+    0x50, 4, 0x6a, 5, 0x7c, 6, 0x81, 7, 0x9e, 8, 0xa0, 9, 0xb3, 10, 0xc7, 11,
+    0xd1, 12, 0xe5, 13, 0xf0, 14, 0xff, 15));
+
+static_assert(handlers.at(0xff) == 15, "");
+
+// The runtime `make_unordered_map` from the previous code segments, for
+// comparison.
+
+template <typename, typename>
+struct forNArgsImpl;
+
+template <std::size_t TArity, typename TF, typename... Ts>
+void forNArgs(TF&& mFn, Ts&&... mXs)
+{
+    constexpr auto numberOfArgs(sizeof...(Ts));
+
+    static_assert(numberOfArgs % TArity == 0, "Invalid number of arguments");
+
+    forNArgsImpl<std::make_index_sequence<numberOfArgs / TArity>,
+        std::make_index_sequence<TArity>>::exec(mFn,
+        std::forward_as_tuple(std::forward<Ts>(mXs)...));
+}
+
+template <std::size_t... TNCalls, std::size_t... TNArity>
+struct forNArgsImpl<std::index_sequence<TNCalls...>,
+    std::index_sequence<TNArity...>>
+{
+    template <typename TF, typename... Ts>
+    static void exec(TF&& mFn, std::tuple<Ts...>&& mXs)
+    {
+        constexpr auto arity(sizeof...(TNArity));
+        using swallow = bool[];
+
+        (void)swallow{
+            (execN<TNCalls * arity>(mFn, std::move(mXs)), true)...};
+    }
+
+    template <std::size_t TNBase, typename TF, typename... Ts>
+    static void execN(TF&& mFn, std::tuple<Ts...>&& mXs)
+    {
+        mFn(std::get<TNBase + TNArity>(std::move(mXs))...);
+    }
+};
+
+template <typename... TArgs>
+auto make_unordered_map(TArgs&&... mArgs)
+{
+    using KeyType = CommonKeyType<TArgs...>;
+    using ValueType = CommonValueType<TArgs...>;
+
+    std::unordered_map<KeyType, ValueType> result;
+    result.reserve(sizeof...(TArgs) / 2);
+
+    forNArgs<2>(
+        [&result](auto&& k, auto&& v)
+        {
+            result.emplace(
+                std::forward<decltype(k)>(k), std::forward<decltype(v)>(v));
+        },
+
+        std::forward<TArgs>(mArgs)...);
+
+    return result;
+}
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* mTitle, TF&& mFn)
+{
+    auto start(HRClock::now());
+    auto result(mFn());
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+              << ")\n";
+}
+
+void benchmark(std::size_t mN)
+{
+    using namespace std::literals;
+
+    auto m(make_unordered_map("mov"s, 0, "add"s, 1, "sub"s, 2, "mul"s, 3,
+        "div"s, 4, "jmp"s, 5, "cmp"s, 6, "ret"s, 7, "call"s, 8, "push"s, 9,
+        "pop"s, 10, "and"s, 11, "or"s, 12, "xor"s, 13, "not"s, 14, "nop"s, 15));
+
+    // A "program" to dispatch. Keys are pre-built as `std::string` for the
+    // runtime map, so that no temporary strings are measured.
+    std::vector<const char*> program;
+    std::vector<std::string> programStrings;
+
+    const char* names[]{"mov", "add", "sub", "mul", "div", "jmp", "cmp",
+        "ret", "call", "push", "pop", "and", "or", "xor", "not", "nop"};
+
+    for(std::size_t i(0); i < 4096; ++i)
+    {
+        program.emplace_back(names[(i * 7 + i / 3) % 16]);
+        programStrings.emplace_back(program.back());
+    }
+
+    std::cout << mN << " lookups\n";
+
+    bench("std::unordered_map<std::string, int>", [&]
+        {
+            long long sum{0};
+            for(std::size_t i(0); i < mN; ++i)
+                sum += m.find(programStrings[i % 4096])->second;
+
+            return sum;
+        });
+
+    bench("StaticMap<const char*, int, 16>", [&]
+        {
+            long long sum{0};
+            for(std::size_t i(0); i < mN; ++i)
+                sum += *opcodes.find(program[i % 4096]);
+
+            return sum;
+        });
+
+    auto mi(make_unordered_map(0x10, 0, 0x22, 1, 0x31, 2, 0x4f, 3, 0x50, 4,
+        0x6a, 5, 0x7c, 6, 0x81, 7, 0x9e, 8, 0xa0, 9, 0xb3, 10, 0xc7, 11, 0xd1,
+        12, 0xe5, 13, 0xf0, 14, 0xff, 15));
+
+    const int codes[]{0x10, 0x22, 0x31, 0x4f, 0x50, 0x6a, 0x7c, 0x81, 0x9e,
+        0xa0, 0xb3, 0xc7, 0xd1, 0xe5, 0xf0, 0xff};
+
+    std::vector<int> intProgram;
+    for(std::size_t i(0); i < 4096; ++i)
+        intProgram.emplace_back(codes[(i * 7 + i / 3) % 16]);
+
+    bench("std::unordered_map<int, int>", [&]
+        {
+            long long sum{0};
+            for(std::size_t i(0); i < mN; ++i)
+                sum += mi.find(intProgram[i % 4096])->second;
+
+            return sum;
+        });
+
+    bench("StaticMap<int, int, 16>", [&]
+        {
+            long long sum{0};
+            for(std::size_t i(0); i < mN; ++i)
+                sum += *handlers.find(intProgram[i % 4096]);
+
+            return sum;
+        });
+}
+
+int main()
+{
+    // Prints "8 15".
+    std::cout << opcodes.at("call") << " " << opcodes.at("nop") << "\n";
+
+    benchmark(10000000);
+    return 0;
+}
+
+// `StaticMap` requires no heap allocation and no startup work: the perfect
+// hash table is computed by the compiler and placed in read-only memory.
@@ -0,0 +1,468 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// `forArgs` and `forTuple` call the passed function on every argument, one
+// after the other. When every call is independent and expensive - think of
+// initializing a dozen unrelated subsystems at startup - we're wasting time
+// leaving the other cores idle.
+
+// In this code segment we'll implement `parallelForArgs` and
+// `parallelForTuple`: they run every call as a task on a thread pool, and
+// wait for all of them before returning.
+
+// (Remember to compile this code segment with `-pthread`.)
+
+template <typename TF, typename... Ts>
+void forArgs(TF&& mFn, Ts&&... mArgs)
+{
+    return (void)std::initializer_list<int>{
+        (mFn(std::forward<Ts>(mArgs)), 0)...};
+}
+
+template <typename F, typename Tuple, size_t... I>
+decltype(auto) apply_impl(F&& f, Tuple&& t, std::index_sequence<I...>)
+{
+    return std::forward<F>(f)(std::get<I>(std::forward<Tuple>(t))...);
+}
+
+template <typename F, typename Tuple>
+decltype(auto) apply(F&& f, Tuple&& t)
+{
+    using Indices =
+        std::make_index_sequence<std::tuple_size<std::decay_t<Tuple>>::value>;
+
+    return apply_impl(std::forward<F>(f), std::forward<Tuple>(t), Indices{});
+}
+
+template <typename TFn, typename TTpl>
+void forTuple(TFn&& mFn, TTpl&& mTpl)
+{
+    apply(
+        [&mFn](auto&&... xs)
+        {
+            forArgs(mFn, std::forward<decltype(xs)>(xs)...);
+        },
+
+        std::forward<TTpl>(mTpl));
+}
+
+// ----------------------------------------------------------------
+
+// A minimal thread pool. Besides the usual `post`, it allows the caller to
+// run a pending task on its own thread with `runPendingTask`: a thread
+// waiting for its tasks to complete can help instead of sleeping.
+
+class ThreadPool
+{
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping{false};
+
+    void workerLoop()
+    {
+        while(true)
+        {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                cv.wait(lock, [this]
+                    {
+                        return stopping || !tasks.empty();
+                    });
+
+                if(stopping && tasks.empty()) return;
+
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+
+            task();
+        }
+    }
+
+public:
+    explicit ThreadPool(std::size_t mThreadCount)
+    {
+        for(std::size_t i(0); i < mThreadCount; ++i)
+            workers.emplace_back([this]
+                {
+                    workerLoop();
+                });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Pending tasks are still executed before the workers are joined.
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+
+        cv.notify_all();
+        for(auto& w : workers) w.join();
+    }
+
+    auto size() const noexcept
+    {
+        return workers.size();
+    }
+
+    template <typename TF>
+    void post(TF&& mFn)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            tasks.emplace(std::forward<TF>(mFn));
+        }
+
+        cv.notify_one();
+    }
+
+    // Returns `false` if there was nothing to run.
+    bool runPendingTask()
+    {
+        std::function<void()> task;
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            if(tasks.empty()) return false;
+
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+
+        task();
+        return true;
+    }
+};
+
+// Counts the completed tasks of a single `parallelForArgs` call.
+class Latch
+{
+private:
+    std::size_t remaining;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+public:
+    explicit Latch(std::size_t mCount) : remaining{mCount} {}
+
+    void countDown()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        if(--remaining == 0) cv.notify_all();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        cv.wait(lock, [this]
+            {
+                return remaining == 0;
+            });
+    }
+};
+
+// ----------------------------------------------------------------
+
+// Calls `mFn` on the `TI`-th forwarded argument. The exception, if any, is
+// stored instead of being thrown: it must not escape a pool task.
+
+// `mXs` is the tuple returned by `std::forward_as_tuple`: `std::get` on
+// `std::move(mXs)` preserves the value category of the argument.
+template <std::size_t TI, typename TF, typename TTpl>
+void invokeAt(TF& mFn, TTpl& mXs, std::exception_ptr& mException) noexcept
+{
+    try
+    {
+        mFn(std::get<TI>(std::move(mXs)));
+    }
+    catch(...)
+    {
+        mException = std::current_exception();
+    }
+}
+
+// Posts the `TI`-th call to the pool. The task captures everything by
+// reference: it's safe, as `parallelForArgs` doesn't return until all of its
+// tasks have completed.
+template <std::size_t TI, typename TF, typename TTpl>
+void postAt(ThreadPool& mPool, TF& mFn, TTpl& mXs,
+    std::exception_ptr* mExceptions, Latch& mLatch)
+{
+    // The first call is run by the caller itself.
+    if(TI == 0) return;
+
+    mPool.post([&mFn, &mXs, mExceptions, &mLatch]
+        {
+            invokeAt<TI>(mFn, mXs, mExceptions[TI]);
+            mLatch.countDown();
+        });
+}
+
+template <std::size_t... TIs, typename TF, typename TTpl>
+void parallelForArgsImpl(
+    ThreadPool& mPool, TF& mFn, TTpl& mXs, std::index_sequence<TIs...>)
+{
+    constexpr auto count(sizeof...(TIs));
+
+    // One slot per call, indexed like the arguments.
+    std::exception_ptr exceptions[count];
+    Latch latch{count - 1};
+
+    // Every call but the first one is posted to the pool.
+    (void)std::initializer_list<int>{
+        (postAt<TIs>(mPool, mFn, mXs, exceptions, latch), 0)...};
+
+    // The first call runs on the calling thread. Then the caller helps
+    // executing pending tasks: this also guarantees progress when
+    // `parallelForArgs` is called from inside a pool task.
+    invokeAt<0>(mFn, mXs, exceptions[0]);
+    while(mPool.runPendingTask())
+    {
+    }
+
+    latch.wait();
+
+    // All calls are executed even if some of them throw. The rethrown
+    // exception is the one of the first throwing call in argument order -
+    // the same one a sequential `forArgs` would throw, regardless of
+    // scheduling.
+    for(auto& e : exceptions)
+        if(e) std::rethrow_exception(e);
+}
+
+// The path is chosen at compile-time: small packs - including the empty
+// one - never instantiate `parallelForArgsImpl`, which requires at least
+// two arguments.
+template <typename TF, typename... Ts>
+void parallelForArgsDispatch(
+    std::false_type, ThreadPool&, TF& mFn, Ts&&... mArgs)
+{
+    forArgs(mFn, std::forward<Ts>(mArgs)...);
+}
+
+template <typename TF, typename... Ts>
+void parallelForArgsDispatch(
+    std::true_type, ThreadPool& mPool, TF& mFn, Ts&&... mArgs)
+{
+    if(mPool.size() == 0)
+    {
+        forArgs(mFn, std::forward<Ts>(mArgs)...);
+        return;
+    }
+
+    auto xs(std::forward_as_tuple(std::forward<Ts>(mArgs)...));
+    parallelForArgsImpl(
+        mPool, mFn, xs, std::make_index_sequence<sizeof...(Ts)>{});
+}
+
+// `TMinParallel` is the smallest number of arguments worth parallelizing:
+// packs of cheap calls are better run sequentially, as posting a task to
+// the pool costs a heap allocation and some synchronization.
+
+// `mFn` is called concurrently from multiple threads, and must therefore be
+// safe to do so.
+template <std::size_t TMinParallel = 2, typename TF, typename... Ts>
+void parallelForArgs(ThreadPool& mPool, TF&& mFn, Ts&&... mArgs)
+{
+    constexpr auto count(sizeof...(Ts));
+    using Parallel =
+        std::integral_constant<bool, (count >= 2 && count >= TMinParallel)>;
+
+    parallelForArgsDispatch(
+        Parallel{}, mPool, mFn, std::forward<Ts>(mArgs)...);
+}
+
+// Same implementation as `forTuple`, with `parallelForArgs` in place of
+// `forArgs`.
+template <std::size_t TMinParallel = 2, typename TFn, typename TTpl>
+void parallelForTuple(ThreadPool& mPool, TFn&& mFn, TTpl&& mTpl)
+{
+    apply(
+        [&mPool, &mFn](auto&&... xs)
+        {
+            parallelForArgs<TMinParallel>(
+                mPool, mFn, std::forward<decltype(xs)>(xs)...);
+        },
+
+        std::forward<TTpl>(mTpl));
+}
+
+// ----------------------------------------------------------------
+
+// Simulated subsystems with an expensive, independent initialization.
+// They have different types, like the managers of a real application.
+
+constexpr std::chrono::milliseconds initLatency{50};
+
+template <int TID>
+struct Subsystem
+{
+    bool ready{false};
+
+    void init()
+    {
+        std::this_thread::sleep_for(initLatency);
+        ready = true;
+    }
+};
+
+struct Audio : Subsystem<0> {};
+struct Input : Subsystem<1> {};
+struct Physics : Subsystem<2> {};
+struct Renderer : Subsystem<3> {};
+struct Network : Subsystem<4> {};
+struct Scripting : Subsystem<5> {};
+struct Assets : Subsystem<6> {};
+struct Ui : Subsystem<7> {};
+struct Ai : Subsystem<8> {};
+struct Save : Subsystem<9> {};
+struct Localization : Subsystem<10> {};
+struct Telemetry : Subsystem<11> {};
+
+using Subsystems = std::tuple<Audio, Input, Physics, Renderer, Network,
+    Scripting, Assets, Ui, Ai, Save, Localization, Telemetry>;
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* mTitle, TF&& mFn)
+{
+    auto start(HRClock::now());
+    auto result(mFn());
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+              << ")\n";
+}
+
+int countReady(const Subsystems& mSubsystems)
+{
+    int result{0};
+
+    forTuple(
+        [&result](const auto& s)
+        {
+            result += s.ready;
+        },
+        mSubsystems);
+
+    return result;
+}
+
+void benchmark(ThreadPool& mPool)
+{
+    std::cout << "Initializing " << std::tuple_size<Subsystems>{}
+              << " subsystems\n";
+
+    bench("forTuple", []
+        {
+            Subsystems s;
+            forTuple(
+                [](auto& x)
+                {
+                    x.init();
+                },
+                s);
+
+            return countReady(s);
+        });
+
+    bench("parallelForTuple", [&mPool]
+        {
+            Subsystems s;
+            parallelForTuple(mPool,
+                [](auto& x)
+                {
+                    x.init();
+                },
+                s);
+
+            return countReady(s);
+        });
+}
+
+void exceptions(ThreadPool& mPool)
+{
+    // The calls for `2` and `4` both throw. Whichever finishes first, the
+    // exception for `2` is the one that is rethrown.
+    try
+    {
+        parallelForArgs(mPool,
+            [](int x)
+            {
+                std::this_thread::sleep_for(
+                    std::chrono::milliseconds(10 * (5 - x)));
+
+                if(x % 2 == 0)
+                    throw std::runtime_error{"failed " + std::to_string(x)};
+            },
+            1, 2, 3, 4, 5);
+    }
+    catch(const std::runtime_error& e)
+    {
+        // Prints "failed 2".
+        std::cout << e.what() << "\n";
+    }
+}
+
+int main()
+{
+    ThreadPool pool{std::thread::hardware_concurrency()};
+
+    // Fewer than 8 arguments: runs sequentially, in order.
+    // Prints "1 2 3".
+    parallelForArgs<8>(pool,
+        [](int x)
+        {
+            std::cout << x << " ";
+        },
+        1, 2, 3);
+
+    std::cout << "\n";
+
+    // Empty packs are accepted, like by `forArgs` and `forTuple`: nothing
+    // is called.
+    auto print([](const auto& x)
+        {
+            std::cout << x << " ";
+        });
+
+    parallelForArgs(pool, print);
+    parallelForTuple(pool, print, std::tuple<>{});
+
+    exceptions(pool);
+    benchmark(pool);
+
+    return 0;
+}
+
+// With enough cores, the subsystems are initialized in roughly the time of
+// the slowest one instead of the sum of all of them.
@@ -0,0 +1,345 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// `forTuple` visits the elements of a single tuple. In this code segment
+// we'll use the same building blocks to iterate over several containers
+// in lockstep, and to write a "structure of arrays" container.
+
+// An "array of structures" (AoS) stores whole objects contiguously:
+//
+//     x y vx vy | x y vx vy | x y vx vy | ...
+//
+// A "structure of arrays" (SoA) stores every field in its own column:
+//
+//     x  x  x  ...
+//     y  y  y  ...
+//     vx vx vx ...
+//     vy vy vy ...
+//
+// Loops that touch only some fields read only the columns they need, and
+// consecutive iterations access consecutive memory: the compiler can
+// auto-vectorize them.
+
+template <typename TF, typename... Ts>
+void forArgs(TF&& mFn, Ts&&... mArgs)
+{
+    return (void)std::initializer_list<int>{
+        (mFn(std::forward<Ts>(mArgs)), 0)...};
+}
+
+template <typename F, typename Tuple, size_t... I>
+decltype(auto) apply_impl(F&& f, Tuple&& t, std::index_sequence<I...>)
+{
+    return std::forward<F>(f)(std::get<I>(std::forward<Tuple>(t))...);
+}
+
+template <typename F, typename Tuple>
+decltype(auto) apply(F&& f, Tuple&& t)
+{
+    using Indices =
+        std::make_index_sequence<std::tuple_size<std::decay_t<Tuple>>::value>;
+
+    return apply_impl(std::forward<F>(f), std::forward<Tuple>(t), Indices{});
+}
+
+template <typename TFn, typename TTpl>
+void forTuple(TFn&& mFn, TTpl&& mTpl)
+{
+    apply(
+        [&mFn](auto&&... xs)
+        {
+            forArgs(mFn, std::forward<decltype(xs)>(xs)...);
+        },
+
+        std::forward<TTpl>(mTpl));
+}
+
+// ----------------------------------------------------------------
+
+// `forZip(fn, a, b, c)` calls `fn(a[i], b[i], c[i])` for every index `i`.
+// All containers must have the same size.
+
+// The data pointers are loaded once, before the loop: the loop body is then
+// just `mFn` applied to a few pointer offsets, which is what the
+// auto-vectorizer needs to see.
+template <typename TF, typename... TPtrs>
+void forZipImpl(TF& mFn, std::size_t mSize, TPtrs... mPtrs)
+{
+    for(std::size_t i(0); i < mSize; ++i) mFn(mPtrs[i]...);
+}
+
+template <typename TF, typename TC, typename... TCs>
+void forZip(TF&& mFn, TC&& mC, TCs&&... mCs)
+{
+    auto size(mC.size());
+
+    forArgs(
+        [size](const auto& c)
+        {
+            (void)size;
+            (void)c;
+            assert(c.size() == size);
+        },
+        mCs...);
+
+    forZipImpl(mFn, size, mC.data(), mCs.data()...);
+}
+
+// ----------------------------------------------------------------
+
+// `soa_vector<Ts...>` stores a tuple of `std::vector`, one per field.
+// Elements are pushed and iterated as if they were tuples of `Ts...`.
+
+template <typename... Ts>
+class soa_vector
+{
+private:
+    std::tuple<std::vector<Ts>...> columns;
+
+    template <typename TTpl, std::size_t... TIs>
+    void pushBackImpl(TTpl&& mXs, std::index_sequence<TIs...>)
+    {
+        // Same expansion trick used by `forArgs`: one `emplace_back` per
+        // column, in order. `grown` counts the columns that succeeded.
+        std::size_t grown{0};
+
+        try
+        {
+            (void)std::initializer_list<int>{
+                (std::get<TIs>(columns).emplace_back(
+                     std::get<TIs>(std::move(mXs))),
+                    ++grown, 0)...};
+        }
+        catch(...)
+        {
+            // All columns must keep the same size: the ones that were
+            // already grown lose their new element.
+            std::size_t i{0};
+            forTuple(
+                [&i, grown](auto& c)
+                {
+                    if(i++ < grown) c.pop_back();
+                },
+                columns);
+
+            throw;
+        }
+    }
+
+public:
+    using Indices = std::index_sequence_for<Ts...>;
+
+    template <typename... TArgs>
+    void push_back(TArgs&&... mArgs)
+    {
+        static_assert(sizeof...(TArgs) == sizeof...(Ts),
+            "One argument per column is required");
+
+        pushBackImpl(
+            std::forward_as_tuple(std::forward<TArgs>(mArgs)...), Indices{});
+    }
+
+    void reserve(std::size_t mCapacity)
+    {
+        forTuple(
+            [mCapacity](auto& c)
+            {
+                c.reserve(mCapacity);
+            },
+            columns);
+    }
+
+    void resize(std::size_t mSize)
+    {
+        forTuple(
+            [mSize](auto& c)
+            {
+                c.resize(mSize);
+            },
+            columns);
+    }
+
+    void clear() noexcept
+    {
+        forTuple(
+            [](auto& c)
+            {
+                c.clear();
+            },
+            columns);
+    }
+
+    auto size() const noexcept
+    {
+        return std::get<0>(columns).size();
+    }
+
+    // Direct access to a single column.
+    template <std::size_t TI>
+    auto& column() noexcept
+    {
+        return std::get<TI>(columns);
+    }
+
+    template <std::size_t TI>
+    const auto& column() const noexcept
+    {
+        return std::get<TI>(columns);
+    }
+
+    // Calls `mFn` with references to the fields of every element.
+    template <typename TF>
+    void forEach(TF&& mFn)
+    {
+        apply(
+            [&mFn](auto&... cs)
+            {
+                forZip(mFn, cs...);
+            },
+            columns);
+    }
+
+    template <typename TF>
+    void forEach(TF&& mFn) const
+    {
+        apply(
+            [&mFn](const auto&... cs)
+            {
+                forZip(mFn, cs...);
+            },
+            columns);
+    }
+
+    // Same as `forEach`, restricted to the columns `TIs...`.
+    template <std::size_t... TIs, typename TF>
+    void forColumns(TF&& mFn)
+    {
+        forZip(mFn, std::get<TIs>(columns)...);
+    }
+};
+
+// ----------------------------------------------------------------
+
+void example()
+{
+    std::vector<int> a{1, 2, 3};
+    std::vector<float> b{0.5f, 1.5f, 2.5f};
+    std::vector<char> c{'a', 'b', 'c'};
+
+    // Prints "1 0.5 a | 2 1.5 b | 3 2.5 c | ".
+    forZip(
+        [](int x, float y, char z)
+        {
+            std::cout << x << " " << y << " " << z << " | ";
+        },
+        a, b, c);
+
+    std::cout << "\n";
+
+    soa_vector<int, float> v;
+    v.push_back(1, 1.f);
+    v.push_back(2, 2.f);
+
+    v.forEach([](int& x, float& y)
+        {
+            y *= x;
+        });
+
+    // Prints "1 4".
+    v.forEach([](int, float y)
+        {
+            std::cout << y << " ";
+        });
+
+    std::cout << "\n";
+}
+
+// A particle update loop: AoS against SoA. Only the position and velocity
+// fields are touched, but every AoS particle also carries a "cold" payload
+// that is dragged through the cache.
+
+struct Particle
+{
+    float x, y, vx, vy;
+    float color[4];
+    int life;
+};
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* mTitle, TF&& mFn)
+{
+    auto start(HRClock::now());
+    auto result(mFn());
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+              << ")\n";
+}
+
+void benchmark(std::size_t mN, std::size_t mSteps)
+{
+    std::cout << mN << " particles, " << mSteps << " steps\n";
+
+    std::vector<Particle> aos(mN);
+    soa_vector<float, float, float, float, float, int> soa;
+    soa.reserve(mN);
+
+    for(std::size_t i(0); i < mN; ++i)
+    {
+        auto f(static_cast<float>(i % 100));
+        aos[i] = Particle{f, f, 1.f, 2.f, {1.f, 1.f, 1.f, 1.f}, 100};
+        soa.push_back(f, f, 1.f, 2.f, 1.f, 100);
+    }
+
+    constexpr float dt{0.01f};
+
+    bench("AoS", [&]
+        {
+            for(std::size_t s(0); s < mSteps; ++s)
+                for(auto& p : aos)
+                {
+                    p.x += p.vx * dt;
+                    p.y += p.vy * dt;
+                }
+
+            return aos[mN / 2].x + aos[mN / 2].y;
+        });
+
+    bench("soa_vector", [&]
+        {
+            for(std::size_t s(0); s < mSteps; ++s)
+                soa.forColumns<0, 1, 2, 3>(
+                    [dt](float& x, float& y, float vx, float vy)
+                    {
+                        x += vx * dt;
+                        y += vy * dt;
+                    });
+
+            return soa.column<0>()[mN / 2] + soa.column<1>()[mN / 2];
+        });
+}
+
+int main()
+{
+    example();
+    benchmark(1000000, 200);
+
+    return 0;
+}
+
+// Compile with optimizations enabled: `forZipImpl`'s loop is vectorized,
+// while the AoS loop is limited by the memory bandwidth wasted on the
+// fields it doesn't touch.
@@ -0,0 +1,300 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// `forNArgs<N>` groups variadic arguments N by N, at compile-time. The same
+// "process in groups of N" pattern is very common with run-time buffers:
+// interleaved `x, y, z` coordinates, `key, value` pairs read from a file...
+
+// In this code segment we'll implement two functions that do the same
+// thing on a run-time range of elements:
+//
+// * `forNElems<N>(span, fn)` calls `fn` once per group of `N` elements -
+//   the group is expanded into the call with an index sequence, just like
+//   `forNArgs`.
+//
+// * `forNBatches<N>(span, fn)` calls `fn` once with a batch of all the
+//   groups, so that it can run its own tight loop that the compiler can
+//   vectorize.
+//
+// When the number of elements is not a multiple of N, the incomplete last
+// group is never passed to `fn`: it is returned to the caller instead.
+
+// ----------------------------------------------------------------
+
+// C++14 has no `std::span`: this is a minimal non-owning view over a
+// contiguous range.
+template <typename T>
+class span
+{
+private:
+    T* ptr;
+    std::size_t count;
+
+public:
+    constexpr span(T* mPtr, std::size_t mCount) noexcept
+        : ptr{mPtr}, count{mCount}
+    {
+    }
+
+    template <typename TC>
+    constexpr span(TC& mC) noexcept : ptr{mC.data()}, count{mC.size()}
+    {
+    }
+
+    constexpr auto data() const noexcept
+    {
+        return ptr;
+    }
+
+    constexpr auto size() const noexcept
+    {
+        return count;
+    }
+
+    constexpr auto& operator[](std::size_t mI) const noexcept
+    {
+        return ptr[mI];
+    }
+
+    constexpr auto begin() const noexcept
+    {
+        return ptr;
+    }
+
+    constexpr auto end() const noexcept
+    {
+        return ptr + count;
+    }
+};
+
+template <typename TC>
+auto make_span(TC& mC) noexcept
+{
+    return span<std::remove_pointer_t<decltype(mC.data())>>{mC};
+}
+
+// A batch of `size()` complete groups of `TN` elements each, stored
+// contiguously. `(i, j)` is the `j`-th element of the `i`-th group.
+template <typename T, std::size_t TN>
+class Batch
+{
+private:
+    T* ptr;
+    std::size_t count;
+
+public:
+    static constexpr std::size_t arity{TN};
+
+    constexpr Batch(T* mPtr, std::size_t mCount) noexcept
+        : ptr{mPtr}, count{mCount}
+    {
+    }
+
+    constexpr auto data() const noexcept
+    {
+        return ptr;
+    }
+
+    constexpr auto size() const noexcept
+    {
+        return count;
+    }
+
+    constexpr auto& operator()(std::size_t mI, std::size_t mJ) const noexcept
+    {
+        return ptr[mI * TN + mJ];
+    }
+};
+
+// ----------------------------------------------------------------
+
+// Per-group implementation. `TNArity...` goes from `0` to `TN`, and is used
+// to expand a group of elements into a single call.
+template <typename, typename>
+struct forNElemsImpl;
+
+template <typename T, std::size_t... TNArity>
+struct forNElemsImpl<T, std::index_sequence<TNArity...>>
+{
+    static constexpr std::size_t arity{sizeof...(TNArity)};
+
+    template <typename TF>
+    static void exec(TF& mFn, T* mPtr, std::size_t mGroups)
+    {
+        for(std::size_t i(0); i < mGroups; ++i, mPtr += arity)
+            mFn(mPtr[TNArity]...);
+    }
+};
+
+// Returns the elements of `mSpan` that don't fit in a complete group of
+// `TN` elements.
+template <std::size_t TN, typename T>
+auto remainder(span<T> mSpan) noexcept
+{
+    auto used(mSpan.size() / TN * TN);
+    return span<T>{mSpan.data() + used, mSpan.size() - used};
+}
+
+// Calls `mFn` on every complete group of `TN` elements of `mSpan`, and
+// returns the remaining `mSpan.size() % TN` elements.
+template <std::size_t TN, typename T, typename TF>
+auto forNElems(span<T> mSpan, TF&& mFn)
+{
+    static_assert(TN > 0, "Invalid group size");
+
+    forNElemsImpl<T, std::make_index_sequence<TN>>::exec(
+        mFn, mSpan.data(), mSpan.size() / TN);
+
+    return remainder<TN>(mSpan);
+}
+
+template <std::size_t TN, typename TC, typename TF>
+auto forNElems(TC& mC, TF&& mFn)
+{
+    return forNElems<TN>(make_span(mC), std::forward<TF>(mFn));
+}
+
+// Calls `mFn` once with a `Batch` of all the complete groups of `TN`
+// elements of `mSpan` - unless there are none - and returns the remaining
+// `mSpan.size() % TN` elements.
+template <std::size_t TN, typename T, typename TF>
+auto forNBatches(span<T> mSpan, TF&& mFn)
+{
+    static_assert(TN > 0, "Invalid group size");
+
+    auto groups(mSpan.size() / TN);
+    if(groups > 0) mFn(Batch<T, TN>{mSpan.data(), groups});
+
+    return remainder<TN>(mSpan);
+}
+
+template <std::size_t TN, typename TC, typename TF>
+auto forNBatches(TC& mC, TF&& mFn)
+{
+    return forNBatches<TN>(make_span(mC), std::forward<TF>(mFn));
+}
+
+// ----------------------------------------------------------------
+
+void example()
+{
+    // Key-value pairs, with a missing last value.
+    std::vector<int> kvs{1, 10, 2, 20, 3, 30, 4};
+
+    // Prints "1:10 2:20 3:30 ".
+    auto tail(forNElems<2>(kvs, [](int k, int v)
+        {
+            std::cout << k << ":" << v << " ";
+        }));
+
+    std::cout << "\n";
+
+    // Prints "tail: 4".
+    std::cout << "tail:";
+    for(auto x : tail) std::cout << " " << x;
+    std::cout << "\n";
+
+    // Generic lambdas are always called once per group.
+    // Prints "sum of keys: 6".
+    int keys{0};
+    forNElems<2>(kvs, [&keys](const auto& k, const auto&)
+        {
+            keys += k;
+        });
+
+    std::cout << "sum of keys: " << keys << "\n";
+
+    // The same pairs, processed as a batch.
+    // Prints "sum of values: 60".
+    forNBatches<2>(kvs, [](auto b)
+        {
+            int sum{0};
+            for(std::size_t i(0); i < b.size(); ++i) sum += b(i, 1);
+
+            std::cout << "sum of values: " << sum << "\n";
+        });
+}
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* mTitle, TF&& mFn)
+{
+    auto start(HRClock::now());
+    auto result(mFn());
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+              << ")\n";
+}
+
+// Scales a buffer of interleaved `x, y, z` coordinates. The buffer size is
+// deliberately not a multiple of 3.
+void benchmark(std::size_t mPoints, std::size_t mSteps)
+{
+    std::cout << mPoints << " xyz points, " << mSteps << " steps\n";
+
+    std::vector<float> xyz(mPoints * 3 + 2, 1.f);
+
+    bench("forNElems<3>, per group", [&]
+        {
+            for(std::size_t s(0); s < mSteps; ++s)
+                forNElems<3>(xyz, [](float& x, float& y, float& z)
+                    {
+                        x *= 1.0001f;
+                        y *= 0.9999f;
+                        z *= 1.0002f;
+                    });
+
+            return xyz[0] + xyz[1] + xyz[2];
+        });
+
+    bench("forNBatches<3>", [&]
+        {
+            for(std::size_t s(0); s < mSteps; ++s)
+                forNBatches<3>(xyz, [](Batch<float, 3> b)
+                    {
+                        // The scale factors are expanded to a pattern of 4
+                        // groups (12 floats, a multiple of the vector
+                        // width): the inner loop walks the buffer linearly
+                        // and is fully vectorized.
+                        const float k[]{1.0001f, 0.9999f, 1.0002f, 1.0001f,
+                            0.9999f, 1.0002f, 1.0001f, 0.9999f, 1.0002f,
+                            1.0001f, 0.9999f, 1.0002f};
+
+                        auto p(b.data());
+                        auto n(b.size() * 3);
+                        std::size_t i(0);
+
+                        for(; i + 12 <= n; i += 12)
+                            for(std::size_t j(0); j < 12; ++j) p[i + j] *= k[j];
+
+                        for(; i < n; ++i) p[i] *= k[i % 3];
+                    });
+
+            return xyz[0] + xyz[1] + xyz[2];
+        });
+}
+
+int main()
+{
+    example();
+    benchmark(1000000, 200);
+
+    return 0;
+}
+
+// With optimizations enabled, a simple per-group body like the one above is
+// often vectorized as well. `forNBatches` is for the loops the
+// compiler cannot restructure by itself: reductions, access patterns that
+// span several groups, or hand-written intrinsics.
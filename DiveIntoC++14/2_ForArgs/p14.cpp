@@ -0,0 +1,283 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <cstddef>
+#include <iostream>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+// The metaprogramming we've seen in the previous code segments has a cost
+// that is paid at compile-time: every call instantiates index sequences,
+// tuples and `std::tuple_element_t` lookups, and that cost grows with the
+// number of arguments.
+
+// This code segment is not meant to be run on its own: it's compiled over
+// and over by `compile_bench.sh`, once per implementation and argument
+// count, and the compiler's time and memory usage are recorded.
+
+// The script defines:
+//
+// * `BENCH_VARIANT`, which selects the implementation being measured.
+//
+// * `BENCH_ARGS`, a comma-separated list of integers. Its length is the
+//   number of arguments being passed.
+
+#ifndef BENCH_VARIANT
+#define BENCH_VARIANT 0
+#endif
+
+#ifndef BENCH_ARGS
+#define BENCH_ARGS 0, 1, 2, 3, 4, 5, 6, 7, 8, 9
+#endif
+
+// Every argument gets a distinct type, otherwise the compiler could reuse
+// most instantiations. `Arg<TI>` converts to `int`, so that a common type
+// exists for `make_unordered_map`.
+
+template <int TI>
+struct Arg
+{
+    operator int() const noexcept
+    {
+        return TI;
+    }
+};
+
+template <int... TIs>
+struct ArgList
+{
+};
+
+using Args = ArgList<BENCH_ARGS>;
+
+// ----------------------------------------------------------------
+
+// `forArgs`, as seen in p2.cpp: `std::initializer_list` expansion.
+#if BENCH_VARIANT == 0
+
+template <typename TF, typename... Ts>
+void forArgs(TF&& mFn, Ts&&... mArgs)
+{
+    return (void)std::initializer_list<int>{
+        (mFn(std::forward<Ts>(mArgs)), 0)...};
+}
+
+// `forArgs` implemented with a C++17 fold expression.
+// (Compiled with `-std=c++1z`.)
+#elif BENCH_VARIANT == 1
+
+template <typename TF, typename... Ts>
+void forArgs(TF&& mFn, Ts&&... mArgs)
+{
+    (mFn(std::forward<Ts>(mArgs)), ...);
+}
+
+// `forArgs` implemented with compile-time recursion: one instantiation per
+// argument, each one `N` levels deep.
+#elif BENCH_VARIANT == 2
+
+template <typename TF>
+void forArgs(TF&&)
+{
+}
+
+template <typename TF, typename T, typename... Ts>
+void forArgs(TF&& mFn, T&& mX, Ts&&... mXs)
+{
+    mFn(std::forward<T>(mX));
+    forArgs(mFn, std::forward<Ts>(mXs)...);
+}
+
+// `forNArgs`, as seen in p6.cpp: two index sequences, no recursion.
+#elif BENCH_VARIANT == 3
+
+template <typename, typename>
+struct forNArgsImpl;
+
+template <std::size_t TArity, typename TF, typename... Ts>
+void forNArgs(TF&& mFn, Ts&&... mXs)
+{
+    constexpr auto numberOfArgs(sizeof...(Ts));
+    static_assert(numberOfArgs % TArity == 0, "Invalid number of arguments");
+
+    forNArgsImpl<std::make_index_sequence<numberOfArgs / TArity>,
+        std::make_index_sequence<TArity>>::exec(mFn,
+        std::forward_as_tuple(std::forward<Ts>(mXs)...));
+}
+
+template <std::size_t... TNCalls, std::size_t... TNArity>
+struct forNArgsImpl<std::index_sequence<TNCalls...>,
+    std::index_sequence<TNArity...>>
+{
+    template <typename TF, typename... Ts>
+    static void exec(TF&& mFn, std::tuple<Ts...>&& mXs)
+    {
+        constexpr auto arity(sizeof...(TNArity));
+        using swallow = bool[];
+
+        (void)swallow{
+            (execN<TNCalls * arity>(mFn, std::move(mXs)), true)...};
+    }
+
+    template <std::size_t TNBase, typename TF, typename... Ts>
+    static void execN(TF&& mFn, std::tuple<Ts...>&& mXs)
+    {
+        mFn(std::get<TNBase + TNArity>(std::move(mXs))...);
+    }
+};
+
+// `forNArgs<2>` implemented with compile-time recursion, peeling off two
+// arguments at a time.
+#elif BENCH_VARIANT == 4
+
+template <std::size_t TArity, typename TF>
+void forNArgs(TF&&)
+{
+}
+
+template <std::size_t TArity, typename TF, typename T0, typename T1,
+    typename... Ts>
+void forNArgs(TF&& mFn, T0&& mX0, T1&& mX1, Ts&&... mXs)
+{
+    static_assert(TArity == 2, "Only `forNArgs<2>` is benchmarked");
+
+    mFn(std::forward<T0>(mX0), std::forward<T1>(mX1));
+    forNArgs<TArity>(mFn, std::forward<Ts>(mXs)...);
+}
+
+#endif
+
+// ----------------------------------------------------------------
+
+// `make_unordered_map`'s key and value types deduction.
+
+#if BENCH_VARIANT == 5 || BENCH_VARIANT == 6
+
+template <typename TSeq, typename... Ts>
+struct CommonKVHelper;
+
+#if BENCH_VARIANT == 5
+
+// As seen in p7.cpp: every lookup goes through `std::tuple_element_t`, which
+// standard libraries usually implement recursively.
+template <std::size_t TI, typename... Ts>
+using TypeAt = std::tuple_element_t<TI, std::tuple<Ts...>>;
+
+#else
+
+// Flat `TypeAt`: every type is paired with its index in a single base class
+// list. Overload resolution picks the base matching `TI` in one step,
+// without recursion.
+template <std::size_t TI, typename T>
+struct Indexed
+{
+    using Type = T;
+};
+
+template <typename, typename...>
+struct IndexedList;
+
+template <std::size_t... TIs, typename... Ts>
+struct IndexedList<std::index_sequence<TIs...>, Ts...> : Indexed<TIs, Ts>...
+{
+};
+
+template <std::size_t TI, typename T>
+Indexed<TI, T> selectIndexed(const Indexed<TI, T>&);
+
+template <std::size_t TI, typename... Ts>
+using TypeAt = typename decltype(selectIndexed<TI>(
+    std::declval<IndexedList<std::index_sequence_for<Ts...>, Ts...>>()))::Type;
+
+#endif
+
+template <std::size_t... TIs, typename... Ts>
+struct CommonKVHelper<std::index_sequence<TIs...>, Ts...>
+{
+    static_assert(sizeof...(Ts) % 2 == 0, "");
+
+    using KeyType = std::common_type_t<TypeAt<TIs * 2, Ts...>...>;
+    using ValueType = std::common_type_t<TypeAt<(TIs * 2) + 1, Ts...>...>;
+};
+
+template <typename... Ts>
+using HelperFor =
+    CommonKVHelper<std::make_index_sequence<sizeof...(Ts) / 2>, Ts...>;
+
+template <typename TMap, typename TTpl, std::size_t... TIs>
+void insertPairs(TMap& mMap, TTpl&& mXs, std::index_sequence<TIs...>)
+{
+    (void)std::initializer_list<int>{
+        (mMap.emplace(std::get<TIs * 2>(std::move(mXs)),
+             std::get<(TIs * 2) + 1>(std::move(mXs))),
+            0)...};
+}
+
+template <typename... TArgs>
+auto make_unordered_map(TArgs&&... mArgs)
+{
+    using KeyType = typename HelperFor<TArgs...>::KeyType;
+    using ValueType = typename HelperFor<TArgs...>::ValueType;
+
+    std::unordered_map<KeyType, ValueType> result;
+    result.reserve(sizeof...(TArgs) / 2);
+
+    // The insertion is the same for both variants: only the key and value
+    // types deduction differs.
+    insertPairs(result, std::forward_as_tuple(std::forward<TArgs>(mArgs)...),
+        std::make_index_sequence<sizeof...(TArgs) / 2>{});
+
+    return result;
+}
+
+#endif
+
+// ----------------------------------------------------------------
+
+template <int... TIs>
+int run(ArgList<TIs...>)
+{
+    int result{0};
+
+#if BENCH_VARIANT <= 2
+    forArgs(
+        [&result](int x)
+        {
+            result += x;
+        },
+        Arg<TIs>{}...);
+#elif BENCH_VARIANT <= 4
+    forNArgs<2>(
+        [&result](int k, int v)
+        {
+            result += k * v;
+        },
+        Arg<TIs>{}...);
+#else
+    result += static_cast<int>(make_unordered_map(Arg<TIs>{}...).size());
+#endif
+
+    return result;
+}
+
+int main()
+{
+    std::cout << run(Args{}) << "\n";
+    return 0;
+}
+
+// Things to look for in the results:
+//
+// * Recursive implementations instantiate one function per argument, each
+//   with a shorter pack: their cost grows quadratically.
+//
+// * `forNArgs` avoids recursion, but every `execN` call indexes into a
+//   tuple of all the arguments with `std::get`: with hundreds of arguments
+//   that becomes the bottleneck.
+//
+// * Recent standard libraries implement `std::tuple_element_t` with a
+//   compiler intrinsic, in which case the flat `TypeAt` brings no benefit.
@@ -0,0 +1,620 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The map returned by `make_unordered_map` has `std::string` keys, but it's
+// usually queried with string literals: `m["zero"]` constructs a temporary
+// `std::string` for every lookup - which means a heap allocation, unless the
+// key is short enough for the small string optimization.
+
+// C++14's `std::unordered_map` cannot be queried with anything other than
+// its key type. (Heterogeneous lookup for unordered containers is a C++20
+// feature.) In this code segment we'll write two small hash maps whose
+// `find` accepts any "string-like" type, and a `make_transparent_map`
+// function to build them:
+//
+// * `node_map` stores every key-value pair in its own node, like
+//   `std::unordered_map`.
+//
+// * `flat_map` stores the pairs contiguously, and uses a separate open
+//   addressing index table. It performs one allocation for the pairs and
+//   one for the index, instead of one per element.
+
+// ----------------------------------------------------------------
+
+template <typename, typename>
+struct forNArgsImpl;
+
+template <std::size_t TArity, typename TF, typename... Ts>
+void forNArgs(TF&& mFn, Ts&&... mXs)
+{
+    constexpr auto numberOfArgs(sizeof...(Ts));
+
+    static_assert(numberOfArgs % TArity == 0, "Invalid number of arguments");
+
+    forNArgsImpl<std::make_index_sequence<numberOfArgs / TArity>,
+        std::make_index_sequence<TArity>>::exec(mFn,
+        std::forward_as_tuple(std::forward<Ts>(mXs)...));
+}
+
+template <std::size_t... TNCalls, std::size_t... TNArity>
+struct forNArgsImpl<std::index_sequence<TNCalls...>,
+    std::index_sequence<TNArity...>>
+{
+    template <typename TF, typename... Ts>
+    static void exec(TF&& mFn, std::tuple<Ts...>&& mXs)
+    {
+        constexpr auto arity(sizeof...(TNArity));
+        using swallow = bool[];
+
+        (void)swallow{
+            (execN<TNCalls * arity>(mFn, std::move(mXs)), true)...};
+    }
+
+    template <std::size_t TNBase, typename TF, typename... Ts>
+    static void execN(TF&& mFn, std::tuple<Ts...>&& mXs)
+    {
+        mFn(std::get<TNBase + TNArity>(std::move(mXs))...);
+    }
+};
+
+template <typename TSeq, typename... Ts>
+struct CommonKVHelper;
+
+template <std::size_t... TIs, typename... Ts>
+struct CommonKVHelper<std::index_sequence<TIs...>, Ts...>
+{
+    static_assert(sizeof...(Ts) % 2 == 0, "");
+
+    template <std::size_t TI>
+    using TypeAt = std::tuple_element_t<TI, std::tuple<Ts...>>;
+
+    using KeyType = std::common_type_t<TypeAt<TIs * 2>...>;
+    using ValueType = std::common_type_t<TypeAt<(TIs * 2) + 1>...>;
+};
+
+template <typename... Ts>
+using HelperFor =
+    CommonKVHelper<std::make_index_sequence<sizeof...(Ts) / 2>, Ts...>;
+
+template <typename... Ts>
+using CommonKeyType = typename HelperFor<Ts...>::KeyType;
+
+template <typename... Ts>
+using CommonValueType = typename HelperFor<Ts...>::ValueType;
+
+template <typename... TArgs>
+auto make_unordered_map(TArgs&&... mArgs)
+{
+    using KeyType = CommonKeyType<TArgs...>;
+    using ValueType = CommonValueType<TArgs...>;
+
+    std::unordered_map<KeyType, ValueType> result;
+    result.reserve(sizeof...(TArgs) / 2);
+
+    forNArgs<2>(
+        [&result](auto&& k, auto&& v)
+        {
+            result.emplace(
+                std::forward<decltype(k)>(k), std::forward<decltype(v)>(v));
+        },
+
+        std::forward<TArgs>(mArgs)...);
+
+    return result;
+}
+
+// ----------------------------------------------------------------
+
+// C++14 has no `std::string_view`: this is a minimal non-owning view over a
+// sequence of characters.
+class string_ref
+{
+private:
+    const char* ptr;
+    std::size_t count;
+
+public:
+    string_ref(const char* mPtr) noexcept : ptr{mPtr}, count{std::strlen(mPtr)}
+    {
+    }
+
+    string_ref(const char* mPtr, std::size_t mCount) noexcept
+        : ptr{mPtr}, count{mCount}
+    {
+    }
+
+    string_ref(const std::string& mS) noexcept
+        : ptr{mS.data()}, count{mS.size()}
+    {
+    }
+
+    auto data() const noexcept
+    {
+        return ptr;
+    }
+
+    auto size() const noexcept
+    {
+        return count;
+    }
+
+    friend bool operator==(string_ref mA, string_ref mB) noexcept
+    {
+        return mA.count == mB.count &&
+               std::memcmp(mA.ptr, mB.ptr, mA.count) == 0;
+    }
+};
+
+// `toKeyView` turns every string-like type into a `string_ref`, and leaves
+// every other type untouched. Hashing and comparing the results allows
+// lookups with any string-like type, without constructing an `std::string`.
+
+// Every type convertible to `string_ref` - `const char*`, `char*`, character
+// arrays, `std::string` - takes the string path. Overloading on the exact
+// types is not enough: a mutable `char*` would bind to the generic overload,
+// and be hashed as a pointer.
+template <typename T>
+using IsStringLike = std::is_convertible<const T&, string_ref>;
+
+template <typename T, typename = std::enable_if_t<!IsStringLike<T>{}>>
+const T& toKeyView(const T& mX) noexcept
+{
+    return mX;
+}
+
+inline string_ref toKeyView(string_ref mX) noexcept
+{
+    return mX;
+}
+
+template <typename T, typename = std::enable_if_t<!IsStringLike<T>{}>>
+std::size_t keyHash(const T& mX) noexcept
+{
+    return std::hash<T>{}(mX);
+}
+
+// FNV-1a string hash.
+inline std::size_t keyHash(string_ref mX) noexcept
+{
+    std::uint64_t result{0xcbf29ce484222325ull};
+
+    for(std::size_t i(0); i < mX.size(); ++i)
+    {
+        result ^= static_cast<unsigned char>(mX.data()[i]);
+        result *= 0x100000001b3ull;
+    }
+
+    return static_cast<std::size_t>(result);
+}
+
+struct TransparentHash
+{
+    template <typename T>
+    auto operator()(const T& mX) const noexcept
+    {
+        return keyHash(toKeyView(mX));
+    }
+};
+
+struct TransparentEqual
+{
+    template <typename TA, typename TB>
+    auto operator()(const TA& mA, const TB& mB) const noexcept
+    {
+        return toKeyView(mA) == toKeyView(mB);
+    }
+};
+
+inline std::size_t nextPowerOfTwo(std::size_t mX) noexcept
+{
+    std::size_t result{1};
+    while(result < mX) result *= 2;
+    return result;
+}
+
+// ----------------------------------------------------------------
+
+// Separate chaining: every bucket is a singly-linked list of nodes.
+
+template <typename TK, typename TV>
+class node_map
+{
+private:
+    struct Node
+    {
+        TK key;
+        TV value;
+        Node* next;
+    };
+
+    std::vector<Node*> buckets;
+    std::size_t count{0};
+
+    template <typename T>
+    auto bucketOf(const T& mKey) const noexcept
+    {
+        return TransparentHash{}(mKey) & (buckets.size() - 1);
+    }
+
+    void rehash(std::size_t mBucketCount)
+    {
+        std::vector<Node*> old(mBucketCount, nullptr);
+        old.swap(buckets);
+
+        for(auto n : old)
+            while(n != nullptr)
+            {
+                auto next(n->next);
+                auto& b(buckets[bucketOf(n->key)]);
+
+                n->next = b;
+                b = n;
+                n = next;
+            }
+    }
+
+public:
+    // The bucket count is a power of two, sized for `mCapacity` elements.
+    explicit node_map(std::size_t mCapacity = 0)
+        : buckets(nextPowerOfTwo(mCapacity), nullptr)
+    {
+    }
+
+    node_map(const node_map&) = delete;
+    node_map& operator=(const node_map&) = delete;
+
+    // The moved-from map is left without buckets, as allocating new ones
+    // could throw: `find` and `emplace` handle that case.
+    node_map(node_map&& mX) noexcept
+        : buckets{std::move(mX.buckets)}, count{mX.count}
+    {
+        mX.buckets.clear();
+        mX.count = 0;
+    }
+
+    node_map& operator=(node_map&&) = delete;
+
+    ~node_map()
+    {
+        for(auto n : buckets)
+            while(n != nullptr)
+            {
+                auto next(n->next);
+                delete n;
+                n = next;
+            }
+    }
+
+    auto size() const noexcept
+    {
+        return count;
+    }
+
+    // Returns `false` if the key was already present.
+    template <typename TKArg, typename TVArg>
+    bool emplace(TKArg&& mKey, TVArg&& mValue)
+    {
+        if(find(mKey) != nullptr) return false;
+        if(count + 1 > buckets.size())
+            rehash(buckets.empty() ? 1 : buckets.size() * 2);
+
+        auto& b(buckets[bucketOf(mKey)]);
+        b = new Node{TK(std::forward<TKArg>(mKey)),
+            TV(std::forward<TVArg>(mValue)), b};
+
+        ++count;
+        return true;
+    }
+
+    // Returns a pointer to the value mapped to `mKey`, or `nullptr`.
+    template <typename TQuery>
+    const TV* find(const TQuery& mKey) const noexcept
+    {
+        if(buckets.empty()) return nullptr;
+
+        for(auto n(buckets[bucketOf(mKey)]); n != nullptr; n = n->next)
+            if(TransparentEqual{}(n->key, mKey)) return &n->value;
+
+        return nullptr;
+    }
+
+    template <typename TQuery>
+    const TV& at(const TQuery& mKey) const
+    {
+        auto result(find(mKey));
+        if(result == nullptr) throw std::out_of_range{"key not found"};
+
+        return *result;
+    }
+};
+
+// Open addressing with linear probing. `entries` holds the key-value pairs
+// in insertion order, `index` maps hash slots to positions in `entries`.
+// The index is kept at most half full, so probe sequences stay short.
+
+template <typename TK, typename TV>
+class flat_map
+{
+private:
+    using Entry = std::pair<TK, TV>;
+
+    // Every slot also stores the upper bits of the key's hash: most
+    // mismatching keys are rejected without touching `entries`.
+    // Positions are stored plus one: `0` marks an empty slot.
+    struct Slot
+    {
+        std::uint32_t position;
+        std::uint32_t tag;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<Slot> index;
+
+    static auto tagOf(std::uint64_t mHash) noexcept
+    {
+        return static_cast<std::uint32_t>(mHash >> 32);
+    }
+
+    auto slotOf(std::uint64_t mHash) const noexcept
+    {
+        return static_cast<std::size_t>(mHash) & (index.size() - 1);
+    }
+
+    void insertIndex(std::size_t mPosition)
+    {
+        std::uint64_t h(TransparentHash{}(entries[mPosition].first));
+
+        auto s(slotOf(h));
+        while(index[s].position != 0) s = (s + 1) & (index.size() - 1);
+
+        index[s] = Slot{static_cast<std::uint32_t>(mPosition + 1), tagOf(h)};
+    }
+
+    void rehash(std::size_t mSlotCount)
+    {
+        index.assign(mSlotCount, Slot{0, 0});
+        for(std::size_t i(0); i < entries.size(); ++i) insertIndex(i);
+    }
+
+public:
+    explicit flat_map(std::size_t mCapacity = 0)
+        : index(nextPowerOfTwo(mCapacity * 2), Slot{0, 0})
+    {
+        entries.reserve(mCapacity);
+    }
+
+    auto size() const noexcept
+    {
+        return entries.size();
+    }
+
+    // Returns `false` if the key was already present.
+    template <typename TKArg, typename TVArg>
+    bool emplace(TKArg&& mKey, TVArg&& mValue)
+    {
+        if(find(mKey) != nullptr) return false;
+
+        entries.emplace_back(
+            std::forward<TKArg>(mKey), std::forward<TVArg>(mValue));
+
+        if(entries.size() * 2 > index.size())
+            rehash(index.size() * 2);
+        else
+            insertIndex(entries.size() - 1);
+
+        return true;
+    }
+
+    // Returns a pointer to the value mapped to `mKey`, or `nullptr`.
+    template <typename TQuery>
+    const TV* find(const TQuery& mKey) const noexcept
+    {
+        std::uint64_t h(TransparentHash{}(mKey));
+        auto tag(tagOf(h));
+
+        for(auto s(slotOf(h)); index[s].position != 0;
+            s = (s + 1) & (index.size() - 1))
+        {
+            if(index[s].tag != tag) continue;
+
+            const auto& e(entries[index[s].position - 1]);
+            if(TransparentEqual{}(e.first, mKey)) return &e.second;
+        }
+
+        return nullptr;
+    }
+
+    template <typename TQuery>
+    const TV& at(const TQuery& mKey) const
+    {
+        auto result(find(mKey));
+        if(result == nullptr) throw std::out_of_range{"key not found"};
+
+        return *result;
+    }
+
+    auto begin() const noexcept
+    {
+        return entries.begin();
+    }
+
+    auto end() const noexcept
+    {
+        return entries.end();
+    }
+};
+
+// ----------------------------------------------------------------
+
+// Same deduction and forwarding as `make_unordered_map`. The storage is
+// chosen with `TMap`, and is pre-sized for the passed elements: building
+// the map never rehashes.
+template <template <typename, typename> class TMap = flat_map,
+    typename... TArgs>
+auto make_transparent_map(TArgs&&... mArgs)
+{
+    using KeyType = CommonKeyType<TArgs...>;
+    using ValueType = CommonValueType<TArgs...>;
+
+    TMap<KeyType, ValueType> result(sizeof...(TArgs) / 2);
+
+    forNArgs<2>(
+        [&result](auto&& k, auto&& v)
+        {
+            result.emplace(
+                std::forward<decltype(k)>(k), std::forward<decltype(v)>(v));
+        },
+
+        std::forward<TArgs>(mArgs)...);
+
+    return result;
+}
+
+// ----------------------------------------------------------------
+
+// Counts the heap allocations, to verify that the lookups don't allocate.
+
+std::size_t allocationCount{0};
+
+void* operator new(std::size_t mSize)
+{
+    ++allocationCount;
+
+    if(auto p = std::malloc(mSize)) return p;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* mPtr) noexcept
+{
+    std::free(mPtr);
+}
+
+void operator delete(void* mPtr, std::size_t) noexcept
+{
+    std::free(mPtr);
+}
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* mTitle, TF&& mFn)
+{
+    auto allocations(allocationCount);
+
+    auto start(HRClock::now());
+    auto result(mFn());
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms, "
+              << allocationCount - allocations << " allocations (" << result
+              << ")\n";
+}
+
+// Configuration keys are long enough to defeat the small string
+// optimization.
+const char* const keys[]{"network.connection.timeout",
+    "network.connection.retries", "renderer.shadow.map.resolution",
+    "renderer.antialiasing.samples", "audio.master.volume.percent",
+    "physics.solver.iteration.count", "input.mouse.sensitivity.x",
+    "input.mouse.sensitivity.y"};
+
+template <typename TF>
+auto lookups(std::size_t mN, TF&& mFind)
+{
+    long long result{0};
+    for(std::size_t i(0); i < mN; ++i) result += mFind(keys[(i * 5) % 8]);
+
+    return result;
+}
+
+void benchmark(std::size_t mN)
+{
+    std::cout << mN << " lookups by `const char*`\n";
+
+    // The first key is an `std::string`, so that the common key type is
+    // `std::string` and not `const char*`.
+    auto ms(make_unordered_map(std::string{keys[0]}, 30, keys[1], 3, keys[2],
+        2048, keys[3], 4, keys[4], 80, keys[5], 8, keys[6], 5, keys[7], 6));
+
+    auto mn(make_transparent_map<node_map>(std::string{keys[0]}, 30, keys[1],
+        3, keys[2], 2048, keys[3], 4, keys[4], 80, keys[5], 8, keys[6], 5,
+        keys[7], 6));
+
+    auto mf(make_transparent_map<flat_map>(std::string{keys[0]}, 30, keys[1],
+        3, keys[2], 2048, keys[3], 4, keys[4], 80, keys[5], 8, keys[6], 5,
+        keys[7], 6));
+
+    bench("std::unordered_map<std::string, int>", [&]
+        {
+            return lookups(mN, [&ms](const char* k)
+                {
+                    return ms.find(k)->second;
+                });
+        });
+
+    bench("node_map<std::string, int>", [&]
+        {
+            return lookups(mN, [&mn](const char* k)
+                {
+                    return *mn.find(k);
+                });
+        });
+
+    bench("flat_map<std::string, int>", [&]
+        {
+            return lookups(mN, [&mf](const char* k)
+                {
+                    return *mf.find(k);
+                });
+        });
+}
+
+int main()
+{
+    using namespace std::literals;
+
+    auto m(make_transparent_map("zero"s, 0, "one"s, 1, "two", 2.f));
+
+    static_assert(
+        std::is_same<decltype(m), flat_map<std::string, float>>(), "");
+
+    // Prints "012".
+    std::cout << m.at("zero") << m.at("one") << m.at(string_ref{"two"})
+              << "\n";
+
+    // Keys built at runtime in a mutable buffer are found too, in both
+    // maps.
+    char buf[] = "xne";
+    buf[0] = 'o';
+
+    auto nm(make_transparent_map<node_map>("zero"s, 0, "one"s, 1));
+    assert(m.find(buf) != nullptr && *m.find(buf) == 1.f);
+    assert(nm.find(buf) != nullptr && *nm.find(buf) == 1);
+    assert(m.find(static_cast<char*>(buf)) != nullptr);
+
+    benchmark(10000000);
+    return 0;
+}
+
+// `node_map` and `flat_map` never allocate during lookups. `flat_map` also
+// keeps its entries contiguous, which makes lookups more cache-friendly.
@@ -71,8 +71,14 @@ struct forNArgsImpl<
     // function call (`TArity`).
     std::index_sequence<TNArity...>>
 {
+    // The tuple returned by `std::forward_as_tuple` contains
+    // references (`T&` for lvalues, `T&&` for rvalues). We take it
+    // by rvalue reference, as `std::get` on an rvalue tuple
+    // preserves the value category of every element - taking it
+    // by `const&` would turn every argument into a const lvalue,
+    // silently copying temporaries.
     template <typename TF, typename... Ts>
-    static void exec(TF&& mFn, const std::tuple<Ts...>& mXs)
+    static void exec(TF&& mFn, std::tuple<Ts...>&& mXs)
     {
         // We can retrieve the arity again using the `sizeof...`
         // operator on the `TNArity` index sequence.
@@ -88,7 +94,10 @@ struct forNArgsImpl<
 
             // The code inside `swallow` gets expanded to
             // the number of function calls previously calculated.
-            (execN<TNCalls * arity>(mFn, mXs), true)...};
+            // `std::move` is only a cast here: every `execN`
+            // call retrieves different elements of the tuple,
+            // so no element is ever moved from twice.
+            (execN<TNCalls * arity>(mFn, std::move(mXs)), true)...};
 
         // Example expansion of the above context for a binary
         // function called with 4 arguments:
@@ -117,14 +126,14 @@ struct forNArgsImpl<
     // `execN` simply calls the function getting the correct
     // elements from the tuple containing the forwarded arguments.
     template <std::size_t TNBase, typename TF, typename... Ts>
-    static void execN(TF&& mFn, const std::tuple<Ts...>& mXs)
+    static void execN(TF&& mFn, std::tuple<Ts...>&& mXs)
     {
         // `TNBase` is the base index of the tuple elements
         // we're going to get.
 
         // `Cs...` gets expanded from 0 to the number of arguments
         // per function call (`N`).
-        mFn(std::get<TNBase + TNArity>(mXs)...);
+        mFn(std::get<TNBase + TNArity>(std::move(mXs))...);
 
         // Example expansion of `execN` for the previous
         // binary function example called with 4 arguments:
@@ -35,19 +35,23 @@ template <std::size_t... TNCalls, std::size_t... TNArity>
 struct forNArgsImpl<std::index_sequence<TNCalls...>,
     std::index_sequence<TNArity...>>
 {
+    // The tuple is taken by rvalue reference to preserve the value
+    // category of the arguments: rvalue keys and values are moved
+    // into the map instead of being copied.
     template <typename TF, typename... Ts>
-    static void exec(TF&& mFn, const std::tuple<Ts...>& mXs)
+    static void exec(TF&& mFn, std::tuple<Ts...>&& mXs)
     {
         constexpr auto arity(sizeof...(TNArity));
         using swallow = bool[];
 
-        (void)swallow{(execN<TNCalls * arity>(mFn, mXs), true)...};
+        (void)swallow{
+            (execN<TNCalls * arity>(mFn, std::move(mXs)), true)...};
     }
 
     template <std::size_t TNBase, typename TF, typename... Ts>
-    static void execN(TF&& mFn, const std::tuple<Ts...>& mXs)
+    static void execN(TF&& mFn, std::tuple<Ts...>&& mXs)
     {
-        mFn(std::get<TNBase + TNArity>(mXs)...);
+        mFn(std::get<TNBase + TNArity>(std::move(mXs))...);
     }
 };
 
@@ -0,0 +1,284 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+// Does `make_unordered_map("zero"s, 0, ...)` really move the temporary
+// strings into the map?
+
+// In the original version of `forNArgsImpl`, the tuple of forwarded
+// arguments was taken by `const&`: `std::get` returned const lvalues and
+// every temporary was copied. The previous code segments have been fixed to
+// take the tuple by rvalue reference.
+
+// Let's prove that the fixed version never copies, using instrumented types
+// that count their own copies and moves.
+
+// ----------------------------------------------------------------
+
+template <typename, typename>
+struct forNArgsImpl;
+
+template <std::size_t TArity, typename TF, typename... Ts>
+void forNArgs(TF&& mFn, Ts&&... mXs)
+{
+    constexpr auto numberOfArgs(sizeof...(Ts));
+
+    static_assert(numberOfArgs % TArity == 0, "Invalid number of arguments");
+
+    forNArgsImpl<std::make_index_sequence<numberOfArgs / TArity>,
+        std::make_index_sequence<TArity>>::exec(mFn,
+        std::forward_as_tuple(std::forward<Ts>(mXs)...));
+}
+
+template <std::size_t... TNCalls, std::size_t... TNArity>
+struct forNArgsImpl<std::index_sequence<TNCalls...>,
+    std::index_sequence<TNArity...>>
+{
+    template <typename TF, typename... Ts>
+    static void exec(TF&& mFn, std::tuple<Ts...>&& mXs)
+    {
+        constexpr auto arity(sizeof...(TNArity));
+        using swallow = bool[];
+
+        (void)swallow{
+            (execN<TNCalls * arity>(mFn, std::move(mXs)), true)...};
+    }
+
+    template <std::size_t TNBase, typename TF, typename... Ts>
+    static void execN(TF&& mFn, std::tuple<Ts...>&& mXs)
+    {
+        mFn(std::get<TNBase + TNArity>(std::move(mXs))...);
+    }
+};
+
+template <typename TSeq, typename... Ts>
+struct CommonKVHelper;
+
+template <std::size_t... TIs, typename... Ts>
+struct CommonKVHelper<std::index_sequence<TIs...>, Ts...>
+{
+    static_assert(sizeof...(Ts) % 2 == 0, "");
+
+    template <std::size_t TI>
+    using TypeAt = std::tuple_element_t<TI, std::tuple<Ts...>>;
+
+    using KeyType = std::common_type_t<TypeAt<TIs * 2>...>;
+    using ValueType = std::common_type_t<TypeAt<(TIs * 2) + 1>...>;
+};
+
+template <typename... Ts>
+using HelperFor =
+    CommonKVHelper<std::make_index_sequence<sizeof...(Ts) / 2>, Ts...>;
+
+template <typename... Ts>
+using CommonKeyType = typename HelperFor<Ts...>::KeyType;
+
+template <typename... Ts>
+using CommonValueType = typename HelperFor<Ts...>::ValueType;
+
+template <typename... TArgs>
+auto make_unordered_map(TArgs&&... mArgs)
+{
+    using KeyType = CommonKeyType<TArgs...>;
+    using ValueType = CommonValueType<TArgs...>;
+
+    std::unordered_map<KeyType, ValueType> result;
+    result.reserve(sizeof...(TArgs) / 2);
+
+    forNArgs<2>(
+        [&result](auto&& k, auto&& v)
+        {
+            result.emplace(
+                std::forward<decltype(k)>(k), std::forward<decltype(v)>(v));
+        },
+
+        std::forward<TArgs>(mArgs)...);
+
+    return result;
+}
+
+// ----------------------------------------------------------------
+
+// Our instrumented type: it counts how many times objects of its type have
+// been copied and moved. The `TTag` parameter gives keys and values
+// separate counters.
+
+struct Counters
+{
+    std::size_t copies{0};
+    std::size_t moves{0};
+};
+
+template <typename TTag>
+struct Counted
+{
+    static Counters counters;
+
+    int value;
+
+    Counted(int mValue) noexcept : value{mValue} {}
+
+    Counted(const Counted& mX) noexcept : value{mX.value}
+    {
+        ++counters.copies;
+    }
+
+    Counted(Counted&& mX) noexcept : value{mX.value}
+    {
+        ++counters.moves;
+    }
+
+    Counted& operator=(const Counted& mX) noexcept
+    {
+        value = mX.value;
+        ++counters.copies;
+        return *this;
+    }
+
+    Counted& operator=(Counted&& mX) noexcept
+    {
+        value = mX.value;
+        ++counters.moves;
+        return *this;
+    }
+
+    friend bool operator==(const Counted& mA, const Counted& mB) noexcept
+    {
+        return mA.value == mB.value;
+    }
+};
+
+template <typename TTag>
+Counters Counted<TTag>::counters;
+
+struct KeyTag;
+struct ValueTag;
+
+using Key = Counted<KeyTag>;
+using Value = Counted<ValueTag>;
+
+namespace std
+{
+    template <>
+    struct hash<Key>
+    {
+        auto operator()(const Key& mX) const noexcept
+        {
+            return std::hash<int>{}(mX.value);
+        }
+    };
+}
+
+void resetCounters()
+{
+    Key::counters = Counters{};
+    Value::counters = Counters{};
+}
+
+// ----------------------------------------------------------------
+
+void testForNArgsForwardsRvalues()
+{
+    resetCounters();
+
+    // Parameters taken by value: rvalue arguments must be moved into them.
+    forNArgs<2>(
+        [](Key, Value)
+        {
+        },
+        Key{0}, Value{0}, Key{1}, Value{1});
+
+    assert(Key::counters.copies == 0 && Key::counters.moves == 2);
+    assert(Value::counters.copies == 0 && Value::counters.moves == 2);
+}
+
+void testForNArgsForwardsLvalues()
+{
+    resetCounters();
+
+    Key k0{0}, k1{1};
+    Value v0{0}, v1{1};
+
+    // Lvalue arguments must still be copied, and never moved from.
+    forNArgs<2>(
+        [](Key, Value)
+        {
+        },
+        k0, v0, k1, v1);
+
+    assert(Key::counters.copies == 2 && Key::counters.moves == 0);
+    assert(Value::counters.copies == 2 && Value::counters.moves == 0);
+}
+
+void testForNArgsPassesReferencesThrough()
+{
+    resetCounters();
+
+    Key k{0};
+    Value v{0};
+
+    // Reference parameters must bind directly to the original arguments.
+    forNArgs<2>(
+        [&k, &v](const Key& mK, Value&& mV)
+        {
+            assert(&mK == &k && &mV == &v);
+        },
+        k, std::move(v));
+
+    assert(Key::counters.copies == 0 && Key::counters.moves == 0);
+    assert(Value::counters.copies == 0 && Value::counters.moves == 0);
+}
+
+void testMakeUnorderedMapMovesTemporaries()
+{
+    resetCounters();
+
+    auto m(make_unordered_map(Key{0}, Value{0}, Key{1}, Value{1}, Key{2},
+        Value{2}, Key{3}, Value{3}));
+
+    assert(m.size() == 4);
+
+    // Every temporary is moved exactly once, into its map node.
+    assert(Key::counters.copies == 0 && Key::counters.moves == 4);
+    assert(Value::counters.copies == 0 && Value::counters.moves == 4);
+}
+
+void testMakeUnorderedMapCopiesLvalues()
+{
+    Key k{0};
+    Value v{0};
+
+    resetCounters();
+
+    auto m(make_unordered_map(k, v, Key{1}, Value{1}));
+    assert(m.size() == 2);
+
+    // Only the lvalues are copied.
+    assert(Key::counters.copies == 1 && Key::counters.moves == 1);
+    assert(Value::counters.copies == 1 && Value::counters.moves == 1);
+}
+
+int main()
+{
+    testForNArgsForwardsRvalues();
+    testForNArgsForwardsLvalues();
+    testForNArgsPassesReferencesThrough();
+    testMakeUnorderedMapMovesTemporaries();
+    testMakeUnorderedMapCopiesLvalues();
+
+    std::cout << "All tests passed.\n";
+    return 0;
+}
+
+// With the original `const std::tuple<Ts...>&` signature, the
+// `testMakeUnorderedMapMovesTemporaries` test would report 4 copies and 0
+// moves for both keys and values.
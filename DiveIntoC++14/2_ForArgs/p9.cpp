@@ -0,0 +1,389 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// `make_vector` always returns an `std::vector`, which means a heap
+// allocation every time it is called - even though the number of elements
+// is known at compile-time: it's `sizeof...(TArgs)`.
+
+// In this code segment we'll write two heap-free siblings of `make_vector`,
+// using the same common type deduction and perfect forwarding:
+
+// * `make_array`, that returns an `std::array`.
+// * `make_small_vector`, that returns a vector with inline storage for the
+//   passed elements, which can still grow later.
+
+template <typename TF, typename... Ts>
+void forArgs(TF&& mFn, Ts&&... mArgs)
+{
+    return (void)std::initializer_list<int>{
+        (mFn(std::forward<Ts>(mArgs)), 0)...};
+}
+
+template <typename... TArgs>
+auto make_vector(TArgs&&... mArgs)
+{
+    using VectorItem = std::common_type_t<TArgs...>;
+    std::vector<VectorItem> result;
+    result.reserve(sizeof...(TArgs));
+
+    forArgs(
+        [&result](auto&& x)
+        {
+            result.emplace_back(std::forward<decltype(x)>(x));
+        },
+
+        std::forward<TArgs>(mArgs)...);
+
+    return result;
+}
+
+// ----------------------------------------------------------------
+
+// `make_array` does not even need `forArgs`: `std::array` is an aggregate,
+// so we can expand the arguments directly into its initializer list.
+
+// As C++14 relaxed the restrictions on `constexpr` functions, and as
+// `std::forward` is now `constexpr`, `make_array` can be evaluated at
+// compile-time when all element types are literal types.
+
+template <typename... TArgs>
+constexpr auto make_array(TArgs&&... mArgs)
+{
+    using ArrayItem = std::common_type_t<TArgs...>;
+
+    // The `static_cast` avoids narrowing errors in the braced
+    // initialization, e.g. when mixing `int` and `float`.
+    return std::array<ArrayItem, sizeof...(TArgs)>{
+        {static_cast<ArrayItem>(std::forward<TArgs>(mArgs))...}};
+}
+
+// Evaluated at compile-time.
+constexpr auto a0(make_array(1, 2, 3, 4, 5));
+static_assert(std::is_same<decltype(a0), const std::array<int, 5>>(), "");
+static_assert(a0[0] == 1 && a0[4] == 5, "");
+
+constexpr auto a1(make_array(1, 2.5f, 3));
+static_assert(std::is_same<decltype(a1), const std::array<float, 3>>(), "");
+static_assert(a1[1] == 2.5f, "");
+
+// ----------------------------------------------------------------
+
+// `small_vector<T, TN>` stores up to `TN` elements inline, inside the object
+// itself. When more elements are added, it moves them to the heap and
+// behaves like an `std::vector`.
+
+// It is not a literal type (it has a non-trivial destructor), so it cannot
+// be used in `constexpr` contexts.
+
+template <typename T, std::size_t TN>
+class small_vector
+{
+private:
+    using Storage = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+    Storage inlineStorage[TN > 0 ? TN : 1];
+    T* data{reinterpret_cast<T*>(&inlineStorage[0])};
+    std::size_t size_{0};
+    std::size_t capacity_{TN};
+
+    bool isInline() const noexcept
+    {
+        return data == reinterpret_cast<const T*>(&inlineStorage[0]);
+    }
+
+    // Moves (or copies, if moving could throw) the current elements into
+    // `mNewData`. If that throws, the elements constructed so far are
+    // destroyed and the current buffer is left untouched.
+    void relocateTo(T* mNewData)
+    {
+        std::size_t i(0);
+
+        try
+        {
+            for(; i < size_; ++i)
+                new(mNewData + i) T(std::move_if_noexcept(data[i]));
+        }
+        catch(...)
+        {
+            while(i > 0) mNewData[--i].~T();
+            throw;
+        }
+
+        for(i = 0; i < size_; ++i) data[i].~T();
+    }
+
+    // Slow path of `emplace_back`. `mXs` may refer to one of our elements,
+    // so the new element is constructed before the old ones are relocated
+    // and their buffer is freed.
+    template <typename... Ts>
+    auto& emplaceGrow(Ts&&... mXs)
+    {
+        auto newCapacity(capacity_ == 0 ? 4 : capacity_ * 2);
+        auto newData(
+            static_cast<T*>(::operator new(newCapacity * sizeof(T))));
+        T* result;
+
+        try
+        {
+            result = new(newData + size_) T(std::forward<Ts>(mXs)...);
+        }
+        catch(...)
+        {
+            ::operator delete(newData);
+            throw;
+        }
+
+        try
+        {
+            relocateTo(newData);
+        }
+        catch(...)
+        {
+            result->~T();
+            ::operator delete(newData);
+            throw;
+        }
+
+        if(!isInline()) ::operator delete(data);
+
+        data = newData;
+        capacity_ = newCapacity;
+        ++size_;
+
+        return *result;
+    }
+
+    void destroyAll() noexcept
+    {
+        for(std::size_t i(0); i < size_; ++i) data[i].~T();
+        if(!isInline()) ::operator delete(data);
+    }
+
+public:
+    small_vector() = default;
+
+    small_vector(const small_vector& mX)
+    {
+        for(const auto& x : mX) emplace_back(x);
+    }
+
+    // Heap buffers are stolen. Inline elements have to be moved one by one.
+    small_vector(small_vector&& mX) noexcept(
+        std::is_nothrow_move_constructible<T>{})
+    {
+        if(mX.isInline())
+        {
+            for(auto& x : mX) emplace_back(std::move(x));
+            return;
+        }
+
+        data = mX.data;
+        size_ = mX.size_;
+        capacity_ = mX.capacity_;
+
+        mX.data = reinterpret_cast<T*>(&mX.inlineStorage[0]);
+        mX.size_ = 0;
+        mX.capacity_ = TN;
+    }
+
+    small_vector& operator=(const small_vector&) = delete;
+    small_vector& operator=(small_vector&&) = delete;
+
+    ~small_vector() noexcept
+    {
+        destroyAll();
+    }
+
+    template <typename... Ts>
+    auto& emplace_back(Ts&&... mXs)
+    {
+        if(size_ == capacity_)
+            return emplaceGrow(std::forward<Ts>(mXs)...);
+
+        auto& result(*new(data + size_) T(std::forward<Ts>(mXs)...));
+        ++size_;
+
+        return result;
+    }
+
+    auto size() const noexcept
+    {
+        return size_;
+    }
+
+    auto capacity() const noexcept
+    {
+        return capacity_;
+    }
+
+    auto onHeap() const noexcept
+    {
+        return !isInline();
+    }
+
+    auto& operator[](std::size_t mI) noexcept
+    {
+        return data[mI];
+    }
+
+    const auto& operator[](std::size_t mI) const noexcept
+    {
+        return data[mI];
+    }
+
+    auto begin() noexcept
+    {
+        return data;
+    }
+
+    auto end() noexcept
+    {
+        return data + size_;
+    }
+
+    auto begin() const noexcept
+    {
+        return static_cast<const T*>(data);
+    }
+
+    auto end() const noexcept
+    {
+        return static_cast<const T*>(data + size_);
+    }
+};
+
+// `make_small_vector` is identical to `make_vector`, except for the return
+// type: the inline capacity is exactly the number of passed arguments.
+
+template <typename... TArgs>
+auto make_small_vector(TArgs&&... mArgs)
+{
+    using VectorItem = std::common_type_t<TArgs...>;
+    small_vector<VectorItem, sizeof...(TArgs)> result;
+
+    forArgs(
+        [&result](auto&& x)
+        {
+            result.emplace_back(std::forward<decltype(x)>(x));
+        },
+
+        std::forward<TArgs>(mArgs)...);
+
+    return result;
+}
+
+// ----------------------------------------------------------------
+
+void example()
+{
+    // Deduced as `std::array<std::string, 3>`.
+    auto a(make_array("hello", " ", std::string{"world"}));
+    static_assert(std::is_same<decltype(a), std::array<std::string, 3>>(), "");
+
+    // Prints "hello world".
+    for(const auto& x : a) std::cout << x;
+    std::cout << "\n";
+
+    // Deduced as `small_vector<int, 5>`.
+    auto v(make_small_vector(1, 2, 3, 4, 5));
+    static_assert(std::is_same<decltype(v), small_vector<int, 5>>(), "");
+    assert(!v.onHeap());
+
+    // The sixth element moves the contents to the heap.
+    v.emplace_back(6);
+    assert(v.onHeap() && v.size() == 6);
+
+    // Prints "123456".
+    for(const auto& x : v) std::cout << x;
+    std::cout << "\n";
+
+    // The argument may refer to an element of the vector, even when the
+    // insertion reallocates.
+    auto s(make_small_vector(std::string{"first"}));
+    for(int i(0); i < 4; ++i) s.emplace_back(s[0]);
+    assert(s.size() == 5 && s[4] == "first");
+}
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* mTitle, TF&& mFn)
+{
+    auto start(HRClock::now());
+    auto result(mFn());
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+              << ")\n";
+}
+
+// Builds and sums a short list in a hot loop. The list contents depend on
+// the loop index, so that the compiler cannot hoist the construction.
+template <typename TF>
+auto sumLists(std::size_t mN, TF&& mMake)
+{
+    long long result{0};
+
+    for(std::size_t i(0); i < mN; ++i)
+    {
+        int x(static_cast<int>(i));
+        for(const auto& y : mMake(x)) result += y;
+    }
+
+    return result;
+}
+
+void benchmark(std::size_t mN)
+{
+    std::cout << mN << " lists of 6 elements\n";
+
+    bench("make_vector", [mN]
+        {
+            return sumLists(mN, [](int x)
+                {
+                    return make_vector(x, x + 1, x + 2, x + 3, x + 4, x + 5);
+                });
+        });
+
+    bench("make_array", [mN]
+        {
+            return sumLists(mN, [](int x)
+                {
+                    return make_array(x, x + 1, x + 2, x + 3, x + 4, x + 5);
+                });
+        });
+
+    bench("make_small_vector", [mN]
+        {
+            return sumLists(mN, [](int x)
+                {
+                    return make_small_vector(
+                        x, x + 1, x + 2, x + 3, x + 4, x + 5);
+                });
+        });
+}
+
+int main()
+{
+    example();
+    benchmark(10000000);
+
+    return 0;
+}
+
+// `make_array` and `make_small_vector` never touch the heap unless the
+// small vector is grown past its inline capacity.
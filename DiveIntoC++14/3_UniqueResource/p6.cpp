@@ -0,0 +1,554 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// In this code segment we'll see how to find out what our `resource::unique`
+// instances are doing at run-time: how many resources of every behavior are
+// alive, how long they live and where they were acquired.
+
+// Collecting this information is expensive. We want it to be opt-in, and we
+// want it to completely disappear from release builds.
+
+// Tracking is enabled by compiling with `-DRESOURCE_TRACKING`. Defining
+// `NDEBUG` always turns it off.
+
+#if defined(RESOURCE_TRACKING) && !defined(NDEBUG)
+#define RESOURCE_TRACKING_ENABLED 1
+#else
+#define RESOURCE_TRACKING_ENABLED 0
+#endif
+
+namespace legacy
+{
+    // A silent version of the legacy API: the tracking report is going to be
+    // our only output.
+
+    template <typename T>
+    auto free_store_new(T* ptr)
+    {
+        return ptr;
+    }
+
+    template <typename T>
+    void free_store_delete(T* ptr)
+    {
+        delete ptr;
+    }
+
+    int open_file()
+    {
+        static int next_id(1);
+        return next_id++;
+    }
+
+    void close_file(int)
+    {
+    }
+}
+
+namespace behavior
+{
+    template <typename T>
+    struct free_store_b
+    {
+        using handle_type = T*;
+
+        handle_type null_handle()
+        {
+            return nullptr;
+        }
+
+        handle_type init(T* ptr)
+        {
+            return legacy::free_store_new<T>(ptr);
+        }
+
+        void deinit(const handle_type& handle)
+        {
+            legacy::free_store_delete(handle);
+        }
+    };
+
+    struct file_b
+    {
+        using handle_type = int;
+
+        handle_type null_handle()
+        {
+            return -1;
+        }
+
+        handle_type init()
+        {
+            return legacy::open_file();
+        }
+
+        void deinit(const handle_type& handle)
+        {
+            legacy::close_file(handle);
+        }
+    };
+}
+
+namespace tracking
+{
+    // Where a resource was acquired. Filled in by the `RESOURCE_SITE()` macro
+    // at the call site.
+    struct acquisition_site
+    {
+        const char* _file;
+        int _line;
+    };
+
+#define RESOURCE_SITE() ::tracking::acquisition_site{__FILE__, __LINE__}
+
+#if RESOURCE_TRACKING_ENABLED
+    // One `tracker` instance exists for every behavior type. It is created on
+    // the first tracked acquisition and prints its report when the program
+    // terminates.
+
+    // Handle types must be usable as `std::unordered_map` keys.
+    template <typename TBehavior>
+    class tracker
+    {
+    public:
+        using handle_type = typename TBehavior::handle_type;
+        using clock = std::chrono::steady_clock;
+
+        // Lifetimes are stored in a logarithmic histogram: bucket `i` counts
+        // the resources that lived for [2^i, 2^(i+1)) microseconds. The first
+        // bucket also counts lifetimes shorter than a microsecond.
+        static constexpr std::size_t bucket_count{32};
+
+    private:
+        struct live_record
+        {
+            clock::time_point _acquired;
+            acquisition_site _site;
+        };
+
+        std::mutex _mutex;
+        std::unordered_map<handle_type, live_record> _live;
+        std::size_t _acquired{0};
+        std::size_t _peak{0};
+        std::array<std::size_t, bucket_count> _lifetimes{};
+
+        // Only one acquisition every `_sample_rate` is added to the per-site
+        // statistics, to keep the tracking overhead bounded on hot paths.
+        std::size_t _sample_rate{1};
+        std::map<std::pair<std::string, int>, std::size_t> _sampled_sites;
+
+        tracker() = default;
+
+        static auto to_us(clock::duration d)
+        {
+            using namespace std::chrono;
+            return static_cast<std::size_t>(
+                duration_cast<microseconds>(d).count());
+        }
+
+        static auto bucket_for(std::size_t us) noexcept
+        {
+            std::size_t result{0};
+            while(us > 1 && result < bucket_count - 1)
+            {
+                us >>= 1;
+                ++result;
+            }
+
+            return result;
+        }
+
+    public:
+        static auto& instance()
+        {
+            static tracker result;
+            return result;
+        }
+
+        ~tracker()
+        {
+            report(std::cerr);
+        }
+
+        void sample_every(std::size_t n)
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            _sample_rate = n == 0 ? 1 : n;
+        }
+
+        void on_acquire(const handle_type& handle, acquisition_site site)
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+
+            _live[handle] = live_record{clock::now(), site};
+            if(_live.size() > _peak) _peak = _live.size();
+
+            if(_acquired++ % _sample_rate == 0)
+                ++_sampled_sites[{site._file, site._line}];
+        }
+
+        void on_release(const handle_type& handle)
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+
+            auto itr(_live.find(handle));
+            if(itr == std::end(_live)) return;
+
+            auto us(to_us(clock::now() - itr->second._acquired));
+            ++_lifetimes[bucket_for(us)];
+
+            _live.erase(itr);
+        }
+
+        auto live()
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            return _live.size();
+        }
+
+        auto peak()
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            return _peak;
+        }
+
+        void report(std::ostream& os)
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+
+            os << "[resource tracking] " << typeid(TBehavior).name() << "\n"
+               << "  acquired: " << _acquired << ", live: " << _live.size()
+               << ", peak: " << _peak << "\n";
+
+            os << "  lifetimes (us):\n";
+            for(std::size_t i(0); i < bucket_count; ++i)
+            {
+                if(_lifetimes[i] == 0) continue;
+
+                os << "    [" << (i == 0 ? 0 : std::size_t{1} << i) << ", "
+                   << (std::size_t{1} << (i + 1)) << "): " << _lifetimes[i]
+                   << "\n";
+            }
+
+            os << "  sampled acquisition sites (1/" << _sample_rate << "):\n";
+            for(const auto& s : _sampled_sites)
+            {
+                os << "    " << s.first.first << ":" << s.first.second
+                   << " x" << s.second << "\n";
+            }
+
+            // Resources still alive at this point have leaked.
+            auto now(clock::now());
+            for(const auto& l : _live)
+            {
+                os << "  leaked: " << l.second._site._file << ":"
+                   << l.second._site._line << " (alive for "
+                   << to_us(now - l.second._acquired) << " us)\n";
+            }
+        }
+    };
+#endif
+}
+
+namespace behavior
+{
+#if RESOURCE_TRACKING_ENABLED
+    // `tracked_b` wraps an existing behavior, notifying the tracker of every
+    // acquisition and release.
+    template <typename TBehavior>
+    struct tracked_b : TBehavior
+    {
+        using handle_type = typename TBehavior::handle_type;
+        using tracker_type = tracking::tracker<TBehavior>;
+
+        template <typename... Ts>
+        handle_type init_at(tracking::acquisition_site site, Ts&&... xs)
+        {
+            auto result(TBehavior::init(std::forward<Ts>(xs)...));
+
+            if(result != this->null_handle())
+                tracker_type::instance().on_acquire(result, site);
+
+            return result;
+        }
+
+        template <typename... Ts>
+        handle_type init(Ts&&... xs)
+        {
+            return init_at({"<unknown>", 0}, std::forward<Ts>(xs)...);
+        }
+
+        void deinit(const handle_type& handle)
+        {
+            if(handle != this->null_handle())
+                tracker_type::instance().on_release(handle);
+
+            TBehavior::deinit(handle);
+        }
+    };
+#else
+    // When tracking is disabled `tracked_b<TBehavior>` is exactly
+    // `TBehavior`: there is nothing left to pay for.
+    template <typename TBehavior>
+    using tracked_b = TBehavior;
+#endif
+}
+
+namespace resource
+{
+    template <typename TBehavior>
+    class unique : TBehavior
+    {
+    public:
+        using behavior_type = TBehavior;
+        using handle_type = typename behavior_type::handle_type;
+
+    private:
+        handle_type _handle;
+
+        auto& as_behavior() noexcept;
+        const auto& as_behavior() const noexcept;
+
+    public:
+        unique() noexcept;
+        ~unique() noexcept;
+
+        unique(const unique&) = delete;
+        unique& operator=(const unique&) = delete;
+
+        explicit unique(const handle_type& handle) noexcept;
+
+        unique(unique&& rhs) noexcept;
+        auto& operator=(unique&&) noexcept;
+
+        auto release() noexcept;
+
+        void reset() noexcept;
+        void reset(const handle_type& handle) noexcept;
+
+        void swap(unique& rhs) noexcept;
+
+        auto get() const noexcept;
+
+        explicit operator bool() const noexcept;
+    };
+
+    template <typename TBehavior>
+    auto& unique<TBehavior>::as_behavior() noexcept
+    {
+        return static_cast<behavior_type&>(*this);
+    }
+
+    template <typename TBehavior>
+    const auto& unique<TBehavior>::as_behavior() const noexcept
+    {
+        return static_cast<const behavior_type&>(*this);
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::unique() noexcept : _handle{as_behavior().null_handle()}
+    {
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::~unique() noexcept
+    {
+        reset();
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::unique(const handle_type& handle) noexcept
+        : _handle{handle}
+    {
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::unique(unique&& rhs) noexcept : _handle{rhs.release()}
+    {
+    }
+
+    template <typename TBehavior>
+    auto& unique<TBehavior>::operator=(unique&& rhs) noexcept
+    {
+        reset(rhs.release());
+        return *this;
+    }
+
+    template <typename TBehavior>
+    auto unique<TBehavior>::release() noexcept
+    {
+        auto temp_handle(_handle);
+        _handle = as_behavior().null_handle();
+        return temp_handle;
+    }
+
+    template <typename TBehavior>
+    void unique<TBehavior>::reset() noexcept
+    {
+        as_behavior().deinit(_handle);
+        _handle = as_behavior().null_handle();
+    }
+
+    template <typename TBehavior>
+    void unique<TBehavior>::reset(const handle_type& handle) noexcept
+    {
+        as_behavior().deinit(_handle);
+        _handle = handle;
+    }
+
+    template <typename TBehavior>
+    void unique<TBehavior>::swap(unique& rhs) noexcept
+    {
+        using std::swap;
+        swap(_handle, rhs._handle);
+    }
+
+    template <typename TBehavior>
+    auto unique<TBehavior>::get() const noexcept
+    {
+        return _handle;
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::operator bool() const noexcept
+    {
+        return _handle != as_behavior().null_handle();
+    }
+}
+
+
+namespace resource
+{
+    namespace impl
+    {
+        template <typename TBehavior, typename... Ts>
+        auto init_at(TBehavior& b, tracking::acquisition_site, Ts&&... xs)
+        {
+            return b.init(std::forward<Ts>(xs)...);
+        }
+
+#if RESOURCE_TRACKING_ENABLED
+        template <typename TBehavior, typename... Ts>
+        auto init_at(behavior::tracked_b<TBehavior>& b,
+            tracking::acquisition_site site, Ts&&... xs)
+        {
+            return b.init_at(site, std::forward<Ts>(xs)...);
+        }
+#endif
+    }
+
+    // The `make_unique_resource` function suggested in the previous code
+    // segment. It also takes the acquisition site, which is simply ignored
+    // when tracking is disabled.
+    template <typename TBehavior, typename... Ts>
+    auto make_unique_resource(tracking::acquisition_site site, Ts&&... xs)
+    {
+        TBehavior b;
+        return unique<TBehavior>{
+            impl::init_at(b, site, std::forward<Ts>(xs)...)};
+    }
+}
+
+using tracked_file_b = behavior::tracked_b<behavior::file_b>;
+using tracked_file = resource::unique<tracked_file_b>;
+
+using tracked_int_b = behavior::tracked_b<behavior::free_store_b<int>>;
+using tracked_int = resource::unique<tracked_int_b>;
+
+#if !RESOURCE_TRACKING_ENABLED
+// In release builds the tracked resources are the very same types as the
+// untracked ones.
+static_assert(
+    std::is_same<tracked_file, resource::unique<behavior::file_b>>(), "");
+
+static_assert(sizeof(tracked_file) == sizeof(int), "");
+static_assert(sizeof(tracked_int) == sizeof(int*), "");
+#endif
+
+// Simulates a server that serves requests using short-lived file handles,
+// while keeping a few long-lived buffers around.
+void example_server()
+{
+#if RESOURCE_TRACKING_ENABLED
+    tracking::tracker<behavior::file_b>::instance().sample_every(16);
+#endif
+
+    std::vector<tracked_int> cache;
+
+    for(int i(0); i < 1000; ++i)
+    {
+        auto f(
+            resource::make_unique_resource<tracked_file_b>(RESOURCE_SITE()));
+
+        if(i % 100 == 0)
+        {
+            cache.emplace_back(resource::make_unique_resource<tracked_int_b>(
+                RESOURCE_SITE(), new int{i}));
+        }
+    }
+
+    // A few requests take much longer...
+    for(int i(0); i < 4; ++i)
+    {
+        auto f(
+            resource::make_unique_resource<tracked_file_b>(RESOURCE_SITE()));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    // ...and one of them leaks its handle: `release()` gives up ownership
+    // without closing the file.
+    auto leaked(
+        resource::make_unique_resource<tracked_file_b>(RESOURCE_SITE()));
+    (void)leaked.release();
+
+#if RESOURCE_TRACKING_ENABLED
+    std::cout << "live files: "
+              << tracking::tracker<behavior::file_b>::instance().live()
+              << ", peak buffers: "
+              << tracking::tracker<behavior::free_store_b<int>>::instance()
+                     .peak()
+              << "\n";
+#endif
+}
+
+int main()
+{
+    example_server();
+
+    // When tracking is enabled, the report for every tracked behavior is
+    // printed to `std::cerr` after `main` returns. For `file_b`, it will look
+    // like this, where `<line>` is the line of the `RESOURCE_SITE()` that
+    // acquired the file - in the first loop of `example_server`, and for
+    // `leaked`:
+    /*
+        [resource tracking] N8behavior6file_bE
+          acquired: 1005, live: 1, peak: 1
+          lifetimes (us):
+            [0, 2): 1000
+            [4096, 8192): 4
+          sampled acquisition sites (1/16):
+            p6.cpp:<line> x63
+          leaked: p6.cpp:<line> (alive for 20517 us)
+    */
+
+    return 0;
+}
+
+// The report tells us which pools need to be bigger (peak count), which
+// resources are kept around for too long (lifetime histogram) and where they
+// come from (acquisition sites) - without slowing down release builds at all.
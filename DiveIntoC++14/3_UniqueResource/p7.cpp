@@ -0,0 +1,640 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// We often store huge amounts of `resource::unique` objects in containers.
+// In this code segment we'll make sure that they are as container-friendly as
+// raw handles:
+
+// 1. `sizeof(unique<B>)` must be equal to `sizeof(B::handle_type)`.
+
+// 2. An "optional unique" must not need an additional discriminator.
+
+// 3. Containers should be able to relocate uniques with `std::memcpy`,
+// instead of calling the move constructor and the destructor for every
+// element.
+
+namespace legacy
+{
+    // Silent legacy API that counts open files, to check for leaks.
+    int open_files{0};
+
+    template <typename T>
+    auto free_store_new(T* ptr)
+    {
+        return ptr;
+    }
+
+    template <typename T>
+    void free_store_delete(T* ptr)
+    {
+        delete ptr;
+    }
+
+    int open_file()
+    {
+        static int next_id(1);
+
+        ++open_files;
+        return next_id++;
+    }
+
+    void close_file(int id)
+    {
+        if(id == -1)
+        {
+            // Do nothing.
+        }
+        else
+        {
+            --open_files;
+        }
+    }
+}
+
+// Our behaviors get a new optional member function: `tombstone_handle()`.
+// It returns a handle value that is different from `null_handle()` and that
+// `init` will never return. We'll use it to represent an empty optional.
+
+namespace behavior
+{
+    template <typename T>
+    struct free_store_b
+    {
+        using handle_type = T*;
+
+        handle_type null_handle()
+        {
+            return nullptr;
+        }
+
+        // The address of a static object can never be returned by `new`.
+        handle_type tombstone_handle()
+        {
+            static std::aligned_storage_t<sizeof(T), alignof(T)> sentinel;
+            return reinterpret_cast<T*>(&sentinel);
+        }
+
+        handle_type init(T* ptr)
+        {
+            return legacy::free_store_new<T>(ptr);
+        }
+
+        void deinit(const handle_type& handle)
+        {
+            legacy::free_store_delete(handle);
+        }
+    };
+
+    struct file_b
+    {
+        using handle_type = int;
+
+        handle_type null_handle()
+        {
+            return -1;
+        }
+
+        // `legacy::open_file` only returns positive ids.
+        handle_type tombstone_handle()
+        {
+            return -2;
+        }
+
+        handle_type init()
+        {
+            return legacy::open_file();
+        }
+
+        void deinit(const handle_type& handle)
+        {
+            legacy::close_file(handle);
+        }
+    };
+}
+
+namespace resource
+{
+    template <typename TBehavior>
+    class unique : TBehavior
+    {
+    public:
+        using behavior_type = TBehavior;
+        using handle_type = typename behavior_type::handle_type;
+
+    private:
+        handle_type _handle;
+
+        auto& as_behavior() noexcept;
+        const auto& as_behavior() const noexcept;
+
+    public:
+        unique() noexcept;
+        ~unique() noexcept;
+
+        unique(const unique&) = delete;
+        unique& operator=(const unique&) = delete;
+
+        explicit unique(const handle_type& handle) noexcept;
+
+        unique(unique&& rhs) noexcept;
+        auto& operator=(unique&&) noexcept;
+
+        auto release() noexcept;
+
+        void reset() noexcept;
+        void reset(const handle_type& handle) noexcept;
+
+        void swap(unique& rhs) noexcept;
+
+        auto get() const noexcept;
+
+        explicit operator bool() const noexcept;
+    };
+
+    template <typename TBehavior>
+    auto& unique<TBehavior>::as_behavior() noexcept
+    {
+        return static_cast<behavior_type&>(*this);
+    }
+
+    template <typename TBehavior>
+    const auto& unique<TBehavior>::as_behavior() const noexcept
+    {
+        return static_cast<const behavior_type&>(*this);
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::unique() noexcept : _handle{as_behavior().null_handle()}
+    {
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::~unique() noexcept
+    {
+        reset();
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::unique(const handle_type& handle) noexcept
+        : _handle{handle}
+    {
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::unique(unique&& rhs) noexcept : _handle{rhs.release()}
+    {
+    }
+
+    template <typename TBehavior>
+    auto& unique<TBehavior>::operator=(unique&& rhs) noexcept
+    {
+        reset(rhs.release());
+        return *this;
+    }
+
+    template <typename TBehavior>
+    auto unique<TBehavior>::release() noexcept
+    {
+        auto temp_handle(_handle);
+        _handle = as_behavior().null_handle();
+        return temp_handle;
+    }
+
+    template <typename TBehavior>
+    void unique<TBehavior>::reset() noexcept
+    {
+        as_behavior().deinit(_handle);
+        _handle = as_behavior().null_handle();
+    }
+
+    template <typename TBehavior>
+    void unique<TBehavior>::reset(const handle_type& handle) noexcept
+    {
+        as_behavior().deinit(_handle);
+        _handle = handle;
+    }
+
+    template <typename TBehavior>
+    void unique<TBehavior>::swap(unique& rhs) noexcept
+    {
+        using std::swap;
+        swap(_handle, rhs._handle);
+    }
+
+    template <typename TBehavior>
+    auto unique<TBehavior>::get() const noexcept
+    {
+        return _handle;
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::operator bool() const noexcept
+    {
+        return _handle != as_behavior().null_handle();
+    }
+}
+
+
+// ----------------------------------------------------------------
+// 1. Size guarantees.
+// ----------------------------------------------------------------
+
+// `unique` privately derives from its behavior, so that stateless behaviors
+// take no space thanks to the "empty base optimization".
+
+template <typename TBehavior>
+constexpr bool has_handle_size()
+{
+    return sizeof(resource::unique<TBehavior>) ==
+           sizeof(typename TBehavior::handle_type);
+}
+
+static_assert(has_handle_size<behavior::file_b>(), "");
+static_assert(has_handle_size<behavior::free_store_b<int>>(), "");
+
+// ----------------------------------------------------------------
+// 2. Compact optional.
+// ----------------------------------------------------------------
+
+// A generic `optional<unique<B>>` would add a `bool` to the handle, which
+// usually doubles the size of the object due to padding.
+
+// We can instead use `tombstone_handle()` as a "niche": an empty optional
+// stores a `unique` holding the tombstone value.
+
+// The stored `unique` is always a real object, and its handle is always
+// read through `get()`: reinterpreting the storage as a raw handle would
+// break strict aliasing, and optimizing compilers do take advantage of that.
+
+// The tombstone must never reach `deinit`, so it is `release()`d before the
+// stored `unique` is assigned to or destroyed.
+
+namespace resource
+{
+    template <typename TBehavior>
+    class compact_optional
+    {
+    public:
+        using behavior_type = TBehavior;
+        using unique_type = unique<TBehavior>;
+        using handle_type = typename behavior_type::handle_type;
+
+    private:
+        unique_type _value;
+
+        static auto tombstone() noexcept
+        {
+            return behavior_type{}.tombstone_handle();
+        }
+
+        // Takes ownership of `u`'s handle. `_value` must not own a
+        // resource.
+        void assign(unique_type&& u) noexcept
+        {
+            _value.release();
+            _value = std::move(u);
+        }
+
+    public:
+        compact_optional() noexcept : _value{tombstone()}
+        {
+        }
+
+        compact_optional(unique_type&& u) noexcept : _value{std::move(u)}
+        {
+        }
+
+        compact_optional(compact_optional&& rhs) noexcept
+            : _value{tombstone()}
+        {
+            if(rhs.has_value()) assign(std::move(*rhs));
+        }
+
+        auto& operator=(compact_optional&& rhs) noexcept
+        {
+            if(rhs.has_value())
+                emplace(std::move(*rhs));
+            else
+                reset();
+
+            return *this;
+        }
+
+        compact_optional(const compact_optional&) = delete;
+        compact_optional& operator=(const compact_optional&) = delete;
+
+        ~compact_optional() noexcept
+        {
+            reset();
+            _value.release();
+        }
+
+        bool has_value() const noexcept
+        {
+            return _value.get() != tombstone();
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return has_value();
+        }
+
+        auto& emplace(unique_type&& u) noexcept
+        {
+            if(has_value()) _value.reset();
+
+            assign(std::move(u));
+            return _value;
+        }
+
+        void reset() noexcept
+        {
+            if(!has_value()) return;
+
+            _value.reset();
+            assign(unique_type{tombstone()});
+        }
+
+        auto& operator*() noexcept
+        {
+            assert(has_value());
+            return _value;
+        }
+
+        const auto& operator*() const noexcept
+        {
+            assert(has_value());
+            return _value;
+        }
+
+        auto operator-> () noexcept
+        {
+            return &**this;
+        }
+
+        auto operator-> () const noexcept
+        {
+            return &**this;
+        }
+    };
+}
+
+static_assert(sizeof(resource::compact_optional<behavior::file_b>) ==
+                  sizeof(int),
+    "");
+
+static_assert(sizeof(resource::compact_optional<behavior::free_store_b<int>>) ==
+                  sizeof(int*),
+    "");
+
+// ----------------------------------------------------------------
+// 3. Trivial relocation.
+// ----------------------------------------------------------------
+
+// "Relocating" an object means moving it to a new address and destroying the
+// source. For most types, including `unique`, this is equivalent to copying
+// its bytes and simply forgetting about the source object.
+
+// The standard does not (yet) have a notion of "trivially relocatable" types,
+// so we define our own trait. Containers that know about it can relocate
+// elements with `std::memcpy`. This is the same convention used by many
+// high-performance container libraries.
+
+namespace resource
+{
+    template <typename T>
+    struct is_trivially_relocatable : std::is_trivially_copyable<T>
+    {
+    };
+
+    // A `unique` is trivially relocatable as long as its handle is trivially
+    // copyable and its behavior holds no state.
+    template <typename TBehavior>
+    struct is_trivially_relocatable<unique<TBehavior>>
+        : std::integral_constant<bool,
+              std::is_trivially_copyable<
+                  typename TBehavior::handle_type>::value &&
+                  std::is_empty<TBehavior>::value>
+    {
+    };
+
+    template <typename TBehavior>
+    struct is_trivially_relocatable<compact_optional<TBehavior>>
+        : is_trivially_relocatable<unique<TBehavior>>
+    {
+    };
+
+    // Relocates `[first, first + n)` into the uninitialized memory at `dest`.
+    template <typename T>
+    void relocate(T* first, std::size_t n, T* dest, std::true_type) noexcept
+    {
+        if(n == 0) return;
+        std::memcpy(static_cast<void*>(dest), static_cast<void*>(first),
+            n * sizeof(T));
+    }
+
+    template <typename T>
+    void relocate(T* first, std::size_t n, T* dest, std::false_type) noexcept
+    {
+        for(std::size_t i(0); i < n; ++i)
+        {
+            new(dest + i) T(std::move(first[i]));
+            first[i].~T();
+        }
+    }
+
+    template <typename T>
+    void relocate(T* first, std::size_t n, T* dest) noexcept
+    {
+        relocate(first, n, dest, is_trivially_relocatable<T>{});
+    }
+
+    // A minimal vector that takes advantage of `is_trivially_relocatable`
+    // when growing.
+    template <typename T>
+    class relocating_vector
+    {
+    private:
+        T* _data{nullptr};
+        std::size_t _size{0};
+        std::size_t _capacity{0};
+
+        // `xs` may refer to one of our elements, so the new element is
+        // constructed before the old ones are relocated and their buffer
+        // is freed.
+        template <typename... Ts>
+        auto& emplace_grow(Ts&&... xs)
+        {
+            auto new_capacity(_capacity == 0 ? 4 : _capacity * 2);
+            auto new_data(static_cast<T*>(
+                ::operator new(new_capacity * sizeof(T))));
+            T* result;
+
+            try
+            {
+                result = new(new_data + _size) T(std::forward<Ts>(xs)...);
+            }
+            catch(...)
+            {
+                ::operator delete(new_data);
+                throw;
+            }
+
+            relocate(_data, _size, new_data);
+            ::operator delete(_data);
+
+            _data = new_data;
+            _capacity = new_capacity;
+            ++_size;
+
+            return *result;
+        }
+
+    public:
+        relocating_vector() = default;
+
+        relocating_vector(const relocating_vector&) = delete;
+        relocating_vector& operator=(const relocating_vector&) = delete;
+
+        ~relocating_vector()
+        {
+            for(std::size_t i(0); i < _size; ++i) _data[i].~T();
+            ::operator delete(_data);
+        }
+
+        template <typename... Ts>
+        auto& emplace_back(Ts&&... xs)
+        {
+            if(_size == _capacity)
+                return emplace_grow(std::forward<Ts>(xs)...);
+
+            auto& result(*new(_data + _size) T(std::forward<Ts>(xs)...));
+            ++_size;
+
+            return result;
+        }
+
+        auto size() const noexcept
+        {
+            return _size;
+        }
+
+        auto& operator[](std::size_t i) noexcept
+        {
+            return _data[i];
+        }
+    };
+}
+
+static_assert(resource::is_trivially_relocatable<
+                  resource::unique<behavior::file_b>>(),
+    "");
+
+static_assert(resource::is_trivially_relocatable<
+                  resource::unique<behavior::free_store_b<int>>>(),
+    "");
+
+static_assert(resource::is_trivially_relocatable<
+                  resource::compact_optional<behavior::file_b>>(),
+    "");
+
+// ----------------------------------------------------------------
+
+void example_compact_optional()
+{
+    using file = resource::unique<behavior::file_b>;
+
+    resource::compact_optional<behavior::file_b> o;
+    assert(!o);
+
+    o.emplace(file{behavior::file_b{}.init()});
+    assert(o && legacy::open_files == 1);
+
+    // An engaged optional can contain a null `unique`.
+    (*o).reset();
+    assert(o && (*o).get() == -1 && legacy::open_files == 0);
+
+    o = file{behavior::file_b{}.init()};
+    o.reset();
+    assert(!o && legacy::open_files == 0);
+}
+
+using hr_clock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* title, TF&& f)
+{
+    auto start(hr_clock::now());
+    f();
+    auto end(hr_clock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << title << ": " << ms.count() << " ms\n";
+    assert(legacy::open_files == 0);
+}
+
+// Fills containers without reserving memory, so that the cost of
+// reallocations dominates.
+void benchmark_growth(std::size_t n)
+{
+    using file = resource::unique<behavior::file_b>;
+
+    std::cout << "growing to " << n << " elements\n";
+
+    bench("std::vector<int>", [n]
+        {
+            std::vector<int> v;
+            for(std::size_t i(0); i < n; ++i)
+                v.emplace_back(legacy::open_file());
+            for(auto h : v) legacy::close_file(h);
+        });
+
+    bench("std::vector<unique<file_b>>", [n]
+        {
+            std::vector<file> v;
+            for(std::size_t i(0); i < n; ++i)
+                v.emplace_back(behavior::file_b{}.init());
+        });
+
+    bench("relocating_vector<unique<file_b>>", [n]
+        {
+            resource::relocating_vector<file> v;
+            for(std::size_t i(0); i < n; ++i)
+                v.emplace_back(behavior::file_b{}.init());
+        });
+
+    bench("relocating_vector<compact_optional<file_b>>", [n]
+        {
+            resource::relocating_vector<
+                resource::compact_optional<behavior::file_b>> v;
+            for(std::size_t i(0); i < n; ++i)
+                v.emplace_back(file{behavior::file_b{}.init()});
+        });
+}
+
+int main(int argc, char** argv)
+{
+    example_compact_optional();
+
+    std::size_t n{1 << 22};
+    if(argc > 1) n = std::strtoull(argv[1], nullptr, 10);
+
+    benchmark_growth(n);
+    return 0;
+}
+
+// `std::vector` has to move-construct every element into the new buffer and
+// then run the destructor of every moved-from `unique`, which calls `deinit`
+// on a null handle. `relocating_vector` simply copies the bytes.
@@ -0,0 +1,456 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// License: Academic Free License ("AFL") v. 3.0
+// AFL License page: http://opensource.org/licenses/AFL-3.0
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// `behavior::free_store_b<T>` allocates and frees every single object on the
+// free store. For objects that only live for a single frame, that's a lot of
+// wasted work: we know in advance that all of them will die at the same time.
+
+// In this code segment we'll implement a "monotonic arena": a memory region
+// from which objects are allocated by simply "bumping" an offset. Objects are
+// never freed individually - the whole arena is released at once.
+
+// We'll then write a new behavior that allocates `unique` objects from an
+// arena. Its `deinit` will only run the destructor.
+
+namespace legacy
+{
+    template <typename T>
+    auto free_store_new(T* ptr)
+    {
+        return ptr;
+    }
+
+    template <typename T>
+    void free_store_delete(T* ptr)
+    {
+        delete ptr;
+    }
+}
+
+namespace memory
+{
+    class monotonic_arena
+    {
+    private:
+        // Memory is obtained from the free store in big chunks. Chunks are
+        // never given back until the arena is destroyed: `release` only
+        // rewinds the arena to the beginning of the first chunk.
+        struct chunk
+        {
+            std::unique_ptr<std::uint8_t[]> _data;
+            std::size_t _size;
+        };
+
+        std::vector<chunk> _chunks;
+        std::size_t _chunk_size;
+
+        std::size_t _current_chunk{0};
+        std::size_t _offset{0};
+
+#ifndef NDEBUG
+        // Number of objects allocated and not yet destroyed. Releasing the
+        // arena while objects are alive would leave dangling handles.
+        std::size_t _live{0};
+#endif
+
+        void add_chunk(std::size_t position, std::size_t size)
+        {
+            _chunks.emplace(_chunks.begin() + position,
+                chunk{std::make_unique<std::uint8_t[]>(size), size});
+        }
+
+        void next_chunk(std::size_t min_size)
+        {
+            ++_current_chunk;
+            _offset = 0;
+
+            // Allocations bigger than a chunk get a dedicated chunk.
+            if(_current_chunk == _chunks.size() ||
+                _chunks[_current_chunk]._size < min_size)
+            {
+                add_chunk(_current_chunk,
+                    min_size > _chunk_size ? min_size : _chunk_size);
+            }
+        }
+
+    public:
+        explicit monotonic_arena(std::size_t chunk_size = 64 * 1024)
+            : _chunk_size{chunk_size}
+        {
+            add_chunk(0, _chunk_size);
+        }
+
+        monotonic_arena(const monotonic_arena&) = delete;
+        monotonic_arena& operator=(const monotonic_arena&) = delete;
+
+        // `alignment` must be a power of two.
+        void* allocate(std::size_t size, std::size_t alignment)
+        {
+            while(true)
+            {
+                auto& c(_chunks[_current_chunk]);
+
+                auto base(reinterpret_cast<std::uintptr_t>(c._data.get()));
+                auto aligned(
+                    ((base + _offset + alignment - 1) & ~(alignment - 1)) -
+                    base);
+
+                if(aligned + size <= c._size)
+                {
+                    _offset = aligned + size;
+
+#ifndef NDEBUG
+                    ++_live;
+#endif
+
+                    return c._data.get() + aligned;
+                }
+
+                next_chunk(size + alignment);
+            }
+        }
+
+        // Called when an object allocated from the arena is destroyed. Its
+        // memory is not reused until the next `release`.
+        void deallocate(void*) noexcept
+        {
+#ifndef NDEBUG
+            assert(_live > 0);
+            --_live;
+#endif
+        }
+
+        // Releases every allocation at once. The cost does not depend on the
+        // number of allocated objects.
+        void release() noexcept
+        {
+#ifndef NDEBUG
+            assert(_live == 0 && "objects still alive in released arena");
+#endif
+
+            _current_chunk = 0;
+            _offset = 0;
+        }
+
+        auto chunk_count() const noexcept
+        {
+            return _chunks.size();
+        }
+    };
+}
+
+namespace behavior
+{
+    template <typename T>
+    struct free_store_b
+    {
+        using handle_type = T*;
+
+        handle_type null_handle()
+        {
+            return nullptr;
+        }
+
+        handle_type init(T* ptr)
+        {
+            return legacy::free_store_new<T>(ptr);
+        }
+
+        void deinit(const handle_type& handle)
+        {
+            legacy::free_store_delete(handle);
+        }
+    };
+
+    // The arena is passed as a reference template parameter: the behavior
+    // stays stateless, so `unique<arena_b<T, a>>` is still pointer-sized.
+    template <typename T, memory::monotonic_arena& TArena>
+    struct arena_b
+    {
+        using handle_type = T*;
+
+        handle_type null_handle()
+        {
+            return nullptr;
+        }
+
+        // Unlike `free_store_b`, `init` constructs the object itself, as the
+        // memory has to come from the arena.
+        template <typename... Ts>
+        handle_type init(Ts&&... xs)
+        {
+            auto ptr(TArena.allocate(sizeof(T), alignof(T)));
+            return new(ptr) T(std::forward<Ts>(xs)...);
+        }
+
+        void deinit(const handle_type& handle)
+        {
+            if(handle == nullptr) return;
+
+            handle->~T();
+            TArena.deallocate(handle);
+        }
+    };
+}
+
+namespace resource
+{
+    template <typename TBehavior>
+    class unique : TBehavior
+    {
+    public:
+        using behavior_type = TBehavior;
+        using handle_type = typename behavior_type::handle_type;
+
+    private:
+        handle_type _handle;
+
+        auto& as_behavior() noexcept;
+        const auto& as_behavior() const noexcept;
+
+    public:
+        unique() noexcept;
+        ~unique() noexcept;
+
+        unique(const unique&) = delete;
+        unique& operator=(const unique&) = delete;
+
+        explicit unique(const handle_type& handle) noexcept;
+
+        unique(unique&& rhs) noexcept;
+        auto& operator=(unique&&) noexcept;
+
+        auto release() noexcept;
+
+        void reset() noexcept;
+        void reset(const handle_type& handle) noexcept;
+
+        void swap(unique& rhs) noexcept;
+
+        auto get() const noexcept;
+
+        explicit operator bool() const noexcept;
+    };
+
+    template <typename TBehavior>
+    auto& unique<TBehavior>::as_behavior() noexcept
+    {
+        return static_cast<behavior_type&>(*this);
+    }
+
+    template <typename TBehavior>
+    const auto& unique<TBehavior>::as_behavior() const noexcept
+    {
+        return static_cast<const behavior_type&>(*this);
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::unique() noexcept : _handle{as_behavior().null_handle()}
+    {
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::~unique() noexcept
+    {
+        reset();
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::unique(const handle_type& handle) noexcept
+        : _handle{handle}
+    {
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::unique(unique&& rhs) noexcept : _handle{rhs.release()}
+    {
+    }
+
+    template <typename TBehavior>
+    auto& unique<TBehavior>::operator=(unique&& rhs) noexcept
+    {
+        reset(rhs.release());
+        return *this;
+    }
+
+    template <typename TBehavior>
+    auto unique<TBehavior>::release() noexcept
+    {
+        auto temp_handle(_handle);
+        _handle = as_behavior().null_handle();
+        return temp_handle;
+    }
+
+    template <typename TBehavior>
+    void unique<TBehavior>::reset() noexcept
+    {
+        as_behavior().deinit(_handle);
+        _handle = as_behavior().null_handle();
+    }
+
+    template <typename TBehavior>
+    void unique<TBehavior>::reset(const handle_type& handle) noexcept
+    {
+        as_behavior().deinit(_handle);
+        _handle = handle;
+    }
+
+    template <typename TBehavior>
+    void unique<TBehavior>::swap(unique& rhs) noexcept
+    {
+        using std::swap;
+        swap(_handle, rhs._handle);
+    }
+
+    template <typename TBehavior>
+    auto unique<TBehavior>::get() const noexcept
+    {
+        return _handle;
+    }
+
+    template <typename TBehavior>
+    unique<TBehavior>::operator bool() const noexcept
+    {
+        return _handle != as_behavior().null_handle();
+    }
+}
+
+
+// A transient per-frame object.
+struct Particle
+{
+    float x, y, vx, vy;
+    int life;
+
+    Particle(float mX, float mY) noexcept
+        : x{mX}, y{mY}, vx{1.f}, vy{-1.f}, life{60}
+    {
+    }
+};
+
+// Arenas used as template arguments need static storage duration.
+memory::monotonic_arena frame_arena;
+
+using heap_particle = resource::unique<behavior::free_store_b<Particle>>;
+using arena_particle =
+    resource::unique<behavior::arena_b<Particle, frame_arena>>;
+
+static_assert(sizeof(arena_particle) == sizeof(Particle*), "");
+
+void example_frame()
+{
+    {
+        std::vector<arena_particle> particles;
+
+        for(int i(0); i < 10; ++i)
+        {
+            // Same `init` style as the other behaviors - but no `new`.
+            particles.emplace_back(
+                behavior::arena_b<Particle, frame_arena>{}.init(i, i));
+        }
+
+        // Resetting a single particle runs its destructor. Its memory will
+        // only be reused after the arena is released.
+        particles.back().reset();
+    }
+
+    // End of frame: all particle memory becomes available again, in O(1).
+    frame_arena.release();
+}
+
+using hr_clock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* title, TF&& f)
+{
+    auto start(hr_clock::now());
+    f();
+    auto end(hr_clock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << title << ": " << ms.count() << " ms\n";
+}
+
+// Simulates `frames` frames that spawn `count` short-lived particles each.
+template <typename TResource, typename TMake, typename TEndFrame>
+void simulate(std::size_t frames, std::size_t count, TMake&& make,
+    TEndFrame&& end_frame)
+{
+    std::vector<TResource> particles;
+    particles.reserve(count);
+
+    float sum{0.f};
+
+    for(std::size_t f(0); f < frames; ++f)
+    {
+        for(std::size_t i(0); i < count; ++i) particles.emplace_back(make(i));
+        for(auto& p : particles) sum += p.get()->x;
+
+        particles.clear();
+        end_frame();
+    }
+
+    // Prevents the loop from being optimized away.
+    if(sum < 0.f) std::cout << sum;
+}
+
+void benchmark_frames(std::size_t frames, std::size_t count)
+{
+    std::cout << frames << " frames, " << count << " particles per frame\n";
+
+    bench("free_store_b", [=]
+        {
+            simulate<heap_particle>(frames, count,
+                [](std::size_t i)
+                {
+                    return behavior::free_store_b<Particle>{}.init(
+                        new Particle(i, i));
+                },
+                []
+                {
+                });
+        });
+
+    bench("arena_b", [=]
+        {
+            simulate<arena_particle>(frames, count,
+                [](std::size_t i)
+                {
+                    return behavior::arena_b<Particle, frame_arena>{}.init(
+                        i, i);
+                },
+                []
+                {
+                    frame_arena.release();
+                });
+        });
+
+    std::cout << "  (arena chunks: " << frame_arena.chunk_count() << ")\n";
+}
+
+int main()
+{
+    example_frame();
+
+    benchmark_frames(1000, 10000);
+    return 0;
+}
+
+// After the first frame the arena has grown to its peak size, and every
+// following frame allocates by simply bumping an offset: no locks, no
+// free-list traversal, no per-object `delete`.
+
+// The price to pay is that all the objects allocated in a frame must die
+// before the frame ends. Debug builds check this in `release()`.
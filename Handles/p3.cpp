@@ -0,0 +1,618 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+// License: Academic Free License ("AFL") v. 3.0
+//          http://opensource.org/licenses/AFL-3.0
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Hello again!
+// Today we'll attach additional data to the entities of the
+// handle-based manager from the previous code segment.
+
+// Entities often need optional data that only some of them have,
+// or that only some systems care about:
+// * Debug names.
+// * Network IDs.
+// * AI "blackboards".
+
+// Adding all of it to `Entity` makes every entity bigger, and
+// slows down iteration for everyone. The typical alternative is
+// an `std::unordered_map<Handle<Entity>, X>`: every lookup hashes
+// the handle and follows pointers between nodes.
+
+// We can do better, thanks to a property of our manager: atoms
+// are moved around during `refresh()`, but marks NEVER move.
+// A mark index is a stable, dense, small integer: the perfect
+// index for a "side table".
+
+std::minstd_rand rndEngine;
+
+using HIdx = std::size_t;
+using HCtr = int;
+
+template <typename>
+class Manager;
+
+template <typename, typename, std::size_t>
+class SideTable;
+
+// `Atom`, `Mark`, `Handle` and `Manager` are the same as in the
+// previous code segment. Refer to it for a detailed explanation.
+
+template <typename T>
+class Atom
+{
+    template <typename>
+    friend class Manager;
+
+private:
+    std::aligned_storage_t<sizeof(T), alignof(T)> data;
+    HIdx markIdx;
+    bool alive{false};
+
+public:
+    Atom(HIdx mMarkIdx) noexcept : markIdx{mMarkIdx} {}
+
+    template <typename... TArgs>
+    void init(TArgs&&... mArgs) noexcept(std::is_nothrow_constructible<T>())
+    {
+        new(&data) T(std::forward<TArgs>(mArgs)...);
+    }
+
+    void deinit() noexcept(std::is_nothrow_destructible<T>()) { get().~T(); }
+
+    T& get() noexcept { return reinterpret_cast<T&>(data); }
+    const T& get() const noexcept { return reinterpret_cast<const T&>(data); }
+
+    static Atom* getAtomFromData(T* mData) noexcept
+    {
+        auto base(reinterpret_cast<char*>(mData) - offsetof(Atom<T>, data));
+        return reinterpret_cast<Atom<T>*>(base);
+    }
+
+    void setDead() noexcept { alive = false; }
+};
+
+struct Mark
+{
+    HIdx atomIdx;
+    HCtr ctr{0};
+
+    Mark(HIdx mAtomIdx) noexcept : atomIdx{mAtomIdx} {}
+};
+
+template <typename T>
+class Handle
+{
+    template <typename>
+    friend class Manager;
+
+    // Side tables are indexed by the handle's mark index.
+    template <typename, typename, std::size_t>
+    friend class SideTable;
+
+    friend struct HandleHash;
+
+private:
+    Manager<T>* manager;
+    HIdx markIdx;
+    HCtr ctr;
+
+    Atom<T>& getAtom() noexcept
+    {
+        assert(manager != nullptr && isAlive());
+        return manager->getAtomFromMark(manager->marks[markIdx]);
+    }
+    const Atom<T>& getAtom() const noexcept
+    {
+        assert(manager != nullptr && isAlive());
+        return manager->getAtomFromMark(manager->marks[markIdx]);
+    }
+
+public:
+    Handle(Manager<T>& mManager, HIdx mMarkIdx, HCtr mCtr) noexcept
+        : manager(&mManager),
+          markIdx{mMarkIdx},
+          ctr{mCtr}
+    {
+    }
+
+    bool isAlive() const noexcept;
+    void destroy() noexcept;
+
+    T& operator*() noexcept { return getAtom().get(); }
+    const T& operator*() const noexcept { return getAtom().get(); }
+    T* operator->() noexcept { return &(getAtom().get()); }
+    const T* operator->() const noexcept { return &(getAtom().get()); }
+
+    // Required to use handles as `std::unordered_map` keys.
+    bool operator==(const Handle& mX) const noexcept
+    {
+        return manager == mX.manager && markIdx == mX.markIdx &&
+               ctr == mX.ctr;
+    }
+};
+
+struct HandleHash
+{
+    template <typename T>
+    std::size_t operator()(const Handle<T>& mX) const noexcept
+    {
+        return std::hash<HIdx>{}(mX.markIdx) ^
+               (std::hash<HCtr>{}(mX.ctr) << 1);
+    }
+};
+
+struct Entity
+{
+    int health;
+    Entity() : health(10 + (rndEngine() % 50)) {}
+    void update()
+    {
+        if(--health <= 0)
+        {
+            Atom<Entity>::getAtomFromData(this)->setDead();
+        }
+    }
+};
+
+template <typename T>
+class Manager
+{
+    template <typename>
+    friend class Handle;
+
+    template <typename, typename, std::size_t>
+    friend class SideTable;
+
+private:
+    std::size_t size{0u};
+    std::size_t sizeNext{0u};
+
+    std::vector<Atom<T>> atoms;
+    std::vector<Mark> marks;
+
+    auto getCapacity() noexcept { return atoms.size(); }
+
+    void growBy(std::size_t mAmount)
+    {
+        auto oldCapacity(getCapacity());
+        auto newCapacity(oldCapacity + mAmount);
+
+        atoms.reserve(newCapacity);
+        marks.reserve(newCapacity);
+
+        for(auto i(oldCapacity); i < newCapacity; ++i)
+        {
+            atoms.emplace_back(i);
+            marks.emplace_back(i);
+        }
+    }
+
+    void destroy(HIdx mMarkIdx) noexcept
+    {
+        getAtomFromMark(marks[mMarkIdx]).setDead();
+    }
+
+    auto& getMarkFromAtom(const Atom<T>& mAtom) noexcept
+    {
+        return marks[mAtom.markIdx];
+    }
+
+    auto& getAtomFromMark(const Mark& mMark) noexcept
+    {
+        return atoms[mMark.atomIdx];
+    }
+
+    auto createHandleFromAtom(Atom<T>& mAtom) noexcept
+    {
+        return Handle<T>{*this, mAtom.markIdx, getMarkFromAtom(mAtom).ctr};
+    }
+
+    template <typename... TArgs>
+    auto& createAtom(TArgs&&... mArgs)
+    {
+        if(getCapacity() <= sizeNext) growBy(10 + getCapacity());
+
+        auto& atom(atoms[sizeNext]);
+        atom.init(std::forward<TArgs>(mArgs)...);
+        atom.alive = true;
+
+        auto& mark(getMarkFromAtom(atom));
+        mark.atomIdx = sizeNext;
+
+        ++sizeNext;
+        return atom;
+    }
+
+public:
+    // Only the first `size` atoms store an entity.
+    void update()
+    {
+        for(std::size_t i(0); i < size; ++i) atoms[i].get().update();
+    }
+
+    void refresh()
+    {
+        const int intSizeNext(sizeNext);
+        int iD{0};
+        int iA{intSizeNext - 1};
+
+        do
+        {
+            for(; true; ++iD)
+            {
+                if(iD > iA) goto finishRefresh;
+                if(!atoms[iD].alive) break;
+            }
+
+            for(; true; --iA)
+            {
+                if(iA <= iD) goto finishRefresh;
+                if(atoms[iA].alive) break;
+            }
+
+            std::swap(atoms[iD], atoms[iA]);
+            getMarkFromAtom(atoms[iD]).atomIdx = iD;
+            getMarkFromAtom(atoms[iA]).atomIdx = iA;
+
+            ++iD;
+            --iA;
+        } while(true);
+
+    finishRefresh:
+
+        size = sizeNext = iD;
+
+        for(; iD < intSizeNext; ++iD)
+        {
+            atoms[iD].deinit();
+            ++(getMarkFromAtom(atoms[iD]).ctr);
+        }
+    }
+
+    template <typename... TArgs>
+    auto create(TArgs&&... mArgs)
+    {
+        return createHandleFromAtom(createAtom(std::forward<TArgs>(mArgs)...));
+    }
+
+    auto getSize() const noexcept { return size; }
+};
+
+template <typename T>
+bool Handle<T>::isAlive() const noexcept
+{
+    return manager->marks[markIdx].ctr == ctr;
+}
+template <typename T>
+void Handle<T>::destroy() noexcept
+{
+    return manager->destroy(markIdx);
+}
+
+// Now, the side table.
+
+// A `SideTable<T, TValue>` stores an optional `TValue` for every
+// entity of a `Manager<T>`. Values are stored in "pages" of
+// `TPageSize` slots: the slot of an entity is found by splitting
+// its mark index in a page index and an offset.
+/*
+    Mark index:      0 ... 255 | 256 ... 511 | 512 ... 767 | ...
+                   ------------------------------------------
+    Pages:         |   page 0  |   nullptr   |   page 2    | ...
+                   ------------------------------------------
+
+    Pages are only allocated when one of their slots is populated,
+    and freed when all of their slots are empty again: we only
+    pay memory for the populated pages.
+*/
+// Every slot also stores the control counter of the entity its
+// value belongs to. When an entity dies, its mark's counter is
+// incremented: values that belonged to it are automatically
+// invalidated, and will be overwritten when a new entity reuses
+// the mark. No notifications from the manager are required.
+
+template <typename T, typename TValue, std::size_t TPageSize = 256>
+class SideTable
+{
+private:
+    struct Slot
+    {
+        std::aligned_storage_t<sizeof(TValue), alignof(TValue)> data;
+        HCtr ctr;
+        bool present{false};
+
+        TValue& get() noexcept { return reinterpret_cast<TValue&>(data); }
+    };
+
+    struct Page
+    {
+        Slot slots[TPageSize];
+
+        // Number of populated slots.
+        std::size_t count{0};
+
+        ~Page()
+        {
+            for(auto& s : slots)
+                if(s.present) s.get().~TValue();
+        }
+    };
+
+    Manager<T>& manager;
+    std::vector<std::unique_ptr<Page>> pages;
+
+    Page* getPage(HIdx mMarkIdx) const noexcept
+    {
+        auto pageIdx(mMarkIdx / TPageSize);
+        return pageIdx < pages.size() ? pages[pageIdx].get() : nullptr;
+    }
+
+    Page& getOrCreatePage(HIdx mMarkIdx)
+    {
+        auto pageIdx(mMarkIdx / TPageSize);
+        if(pageIdx >= pages.size()) pages.resize(pageIdx + 1);
+
+        auto& page(pages[pageIdx]);
+        if(page == nullptr) page.reset(new Page);
+
+        return *page;
+    }
+
+    void eraseSlot(HIdx mMarkIdx, Page& mPage, Slot& mSlot) noexcept
+    {
+        mSlot.get().~TValue();
+        mSlot.present = false;
+
+        if(--mPage.count == 0) pages[mMarkIdx / TPageSize].reset();
+    }
+
+public:
+    SideTable(Manager<T>& mManager) noexcept : manager(mManager) {}
+
+    // Constructs a value for the entity pointed by `mHandle`,
+    // replacing any previous one.
+    template <typename... TArgs>
+    TValue& emplace(const Handle<T>& mHandle, TArgs&&... mArgs)
+    {
+        assert(mHandle.isAlive());
+
+        auto& page(getOrCreatePage(mHandle.markIdx));
+        auto& slot(page.slots[mHandle.markIdx % TPageSize]);
+
+        // The previous value is destroyed first: the slot stays empty
+        // until construction succeeds.
+        if(slot.present)
+        {
+            slot.get().~TValue();
+            slot.present = false;
+            --page.count;
+        }
+
+        try
+        {
+            new(&slot.data) TValue(std::forward<TArgs>(mArgs)...);
+        }
+        catch(...)
+        {
+            // The page may have been created for this value, or have
+            // lost its last one.
+            if(page.count == 0) pages[mHandle.markIdx / TPageSize].reset();
+            throw;
+        }
+
+        ++page.count;
+        slot.present = true;
+        slot.ctr = mHandle.ctr;
+
+        return slot.get();
+    }
+
+    // Returns a pointer to the value of the entity pointed by
+    // `mHandle`, or `nullptr` if the entity has no value or the
+    // handle is not valid anymore.
+    // The lookup is a page pointer load, a slot load and a mark
+    // load: no hashing, no node traversal.
+    TValue* find(const Handle<T>& mHandle) const noexcept
+    {
+        auto page(getPage(mHandle.markIdx));
+        if(page == nullptr) return nullptr;
+
+        auto& slot(page->slots[mHandle.markIdx % TPageSize]);
+
+        // Both the slot and the handle must belong to the entity
+        // currently connected to the mark.
+        auto currentCtr(manager.marks[mHandle.markIdx].ctr);
+        if(!slot.present || slot.ctr != currentCtr || mHandle.ctr != currentCtr)
+            return nullptr;
+
+        return &slot.get();
+    }
+
+    bool contains(const Handle<T>& mHandle) const noexcept
+    {
+        return find(mHandle) != nullptr;
+    }
+
+    void erase(const Handle<T>& mHandle) noexcept
+    {
+        if(find(mHandle) == nullptr) return;
+
+        auto& page(*getPage(mHandle.markIdx));
+        eraseSlot(
+            mHandle.markIdx, page, page.slots[mHandle.markIdx % TPageSize]);
+    }
+
+    // Values of dead entities are invalid, but their memory is only
+    // reclaimed when their slot is reused. `eraseStale` destroys all
+    // of them at once, freeing pages that become empty.
+    void eraseStale() noexcept
+    {
+        for(HIdx p(0); p < pages.size(); ++p)
+        {
+            for(HIdx i(0); i < TPageSize && pages[p] != nullptr; ++i)
+            {
+                auto& page(*pages[p]);
+                auto& slot(page.slots[i]);
+                auto markIdx(p * TPageSize + i);
+
+                if(slot.present && slot.ctr != manager.marks[markIdx].ctr)
+                    eraseSlot(markIdx, page, slot);
+            }
+        }
+    }
+
+    auto getPageCount() const noexcept
+    {
+        return std::count_if(pages.begin(), pages.end(), [](const auto& p)
+            {
+                return p != nullptr;
+            });
+    }
+};
+
+// Let's try it out.
+
+void example()
+{
+    Manager<Entity> m;
+
+    auto h1(m.create());
+    auto h2(m.create());
+    m.refresh();
+
+    SideTable<Entity, std::string> names{m};
+    names.emplace(h1, "player");
+
+    // Prints "player".
+    std::cout << *names.find(h1) << "\n";
+
+    // `h2` has no name. Prints "1".
+    std::cout << (names.find(h2) == nullptr) << "\n";
+
+    // Refreshing the manager moves atoms around, but not marks:
+    // side table entries are not affected.
+    h2.destroy();
+    m.refresh();
+
+    // Prints "player".
+    std::cout << *names.find(h1) << "\n";
+
+    // Once `h1`'s entity dies, its name is invalidated too.
+    h1.destroy();
+    m.refresh();
+
+    // Prints "1".
+    std::cout << (names.find(h1) == nullptr) << "\n";
+
+    // The new entity may reuse `h1`'s mark, but not its name.
+    auto h3(m.create());
+    m.refresh();
+
+    // Prints "1".
+    std::cout << (names.find(h3) == nullptr) << "\n";
+
+    names.eraseStale();
+
+    // Prints "0".
+    std::cout << names.getPageCount() << "\n";
+}
+
+// Let's compare a side table with an `std::unordered_map`.
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* mTitle, TF&& mFn)
+{
+    auto start(HRClock::now());
+    auto result(mFn());
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+              << ")\n";
+}
+
+// One entity in `mRatio` has a network ID. Every "frame", the
+// network ID of every entity is looked up.
+void benchmark(std::size_t mCount, std::size_t mRatio, std::size_t mFrames)
+{
+    std::cout << mFrames << " frames, " << mCount << " entities, one in "
+              << mRatio << " with a network ID\n";
+
+    Manager<Entity> m;
+    std::vector<Handle<Entity>> handles;
+
+    for(std::size_t i(0); i < mCount; ++i) handles.emplace_back(m.create());
+    m.refresh();
+
+    std::unordered_map<Handle<Entity>, int, HandleHash> map;
+    SideTable<Entity, int> table{m};
+
+    for(std::size_t i(0); i < mCount; i += mRatio)
+    {
+        map.emplace(handles[i], static_cast<int>(i));
+        table.emplace(handles[i], static_cast<int>(i));
+    }
+
+    // In a real game, entities are not looked up in creation order.
+    std::shuffle(handles.begin(), handles.end(), rndEngine);
+
+    bench("std::unordered_map", [&]
+        {
+            long long sum(0);
+
+            for(std::size_t f(0); f < mFrames; ++f)
+                for(const auto& h : handles)
+                {
+                    auto itr(map.find(h));
+                    if(itr != map.end()) sum += itr->second;
+                }
+
+            return sum;
+        });
+
+    bench("SideTable", [&]
+        {
+            long long sum(0);
+
+            for(std::size_t f(0); f < mFrames; ++f)
+                for(const auto& h : handles)
+                {
+                    auto p(table.find(h));
+                    if(p != nullptr) sum += *p;
+                }
+
+            return sum;
+        });
+}
+
+int main()
+{
+    example();
+    benchmark(1000000, 4, 100);
+
+    return 0;
+}
+
+// Side tables have a few limitations:
+// * Iterating over all the values of a side table visits every
+//   populated page, including empty slots. Side tables are meant
+//   for lookups, not for iteration.
+// * The memory of a dead entity's value is only reclaimed when
+//   its mark is reused, or when `eraseStale()` is called.
+// * A side table must not outlive its manager.
@@ -0,0 +1,627 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+// License: Academic Free License ("AFL") v. 3.0
+//          http://opensource.org/licenses/AFL-3.0
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Hello again!
+// Today we'll get rid of a hidden cost of our sample `Entity`.
+
+// In the previous code segments, every entity decremented its
+// `health` in every `update()` call, and killed itself when it
+// reached zero. Many game objects work like that: projectiles,
+// particles, temporary effects... they just "wait, then die".
+
+// To count down, every one of these entities is touched every
+// single frame, even though nothing interesting happens to it
+// for most of its life.
+
+// Instead, entities can tell the manager in advance when they
+// need to be destroyed (or woken up), and the manager can keep
+// them in a "timing wheel": a data structure that finds all the
+// events that expire during a tick in O(expired events).
+
+std::minstd_rand rndEngine;
+
+using HIdx = std::size_t;
+using HCtr = int;
+
+// Ticks are counted from the creation of the manager.
+using Tick = std::uint64_t;
+
+template <typename>
+class Manager;
+
+// `Atom`, `Mark`, `Handle` and `Manager` are the same as in the
+// previous code segments. Refer to them for a detailed explanation.
+
+template <typename T>
+class Atom
+{
+    template <typename>
+    friend class Manager;
+
+private:
+    std::aligned_storage_t<sizeof(T), alignof(T)> data;
+    HIdx markIdx;
+    bool alive{false};
+
+public:
+    Atom(HIdx mMarkIdx) noexcept : markIdx{mMarkIdx} {}
+
+    template <typename... TArgs>
+    void init(TArgs&&... mArgs) noexcept(std::is_nothrow_constructible<T>())
+    {
+        new(&data) T(std::forward<TArgs>(mArgs)...);
+    }
+
+    void deinit() noexcept(std::is_nothrow_destructible<T>()) { get().~T(); }
+
+    T& get() noexcept { return reinterpret_cast<T&>(data); }
+    const T& get() const noexcept { return reinterpret_cast<const T&>(data); }
+
+    static Atom* getAtomFromData(T* mData) noexcept
+    {
+        auto base(reinterpret_cast<char*>(mData) - offsetof(Atom<T>, data));
+        return reinterpret_cast<Atom<T>*>(base);
+    }
+
+    void setDead() noexcept { alive = false; }
+};
+
+struct Mark
+{
+    HIdx atomIdx;
+    HCtr ctr{0};
+
+    Mark(HIdx mAtomIdx) noexcept : atomIdx{mAtomIdx} {}
+};
+
+template <typename T>
+class Handle
+{
+    template <typename>
+    friend class Manager;
+
+private:
+    Manager<T>* manager;
+    HIdx markIdx;
+    HCtr ctr;
+
+    Atom<T>& getAtom() noexcept
+    {
+        assert(manager != nullptr && isAlive());
+        return manager->getAtomFromMark(manager->marks[markIdx]);
+    }
+    const Atom<T>& getAtom() const noexcept
+    {
+        assert(manager != nullptr && isAlive());
+        return manager->getAtomFromMark(manager->marks[markIdx]);
+    }
+
+public:
+    Handle(Manager<T>& mManager, HIdx mMarkIdx, HCtr mCtr) noexcept
+        : manager(&mManager),
+          markIdx{mMarkIdx},
+          ctr{mCtr}
+    {
+    }
+
+    bool isAlive() const noexcept;
+    void destroy() noexcept;
+
+    T& operator*() noexcept { return getAtom().get(); }
+    const T& operator*() const noexcept { return getAtom().get(); }
+    T* operator->() noexcept { return &(getAtom().get()); }
+    const T* operator->() const noexcept { return &(getAtom().get()); }
+};
+
+// Now, the timing wheel.
+
+// A timer event refers to an entity exactly like an handle does:
+// through a mark index and a control counter. If the entity dies
+// before the event expires, the counters won't match anymore and
+// the event will simply be skipped.
+enum class TimerAction
+{
+    Destroy,
+    Wake
+};
+
+struct TimerEvent
+{
+    HIdx markIdx;
+    HCtr ctr;
+    Tick deadline;
+    TimerAction action;
+};
+
+// A hierarchical timing wheel works like a clock with multiple
+// hands. Every "level" is an array of `2^TSlotBits` slots, and
+// every slot contains the list of events that expire in it.
+/*
+    Level 0: one slot per tick.
+    Level 1: one slot per `2^TSlotBits` ticks.
+    Level 2: one slot per `2^(2 * TSlotBits)` ticks.
+    ...
+
+    When an event is scheduled, it is put in the lowest level that
+    can represent its deadline.
+
+    Every tick, the level 0 hand moves forward by one slot: all the
+    events in the new slot expire.
+
+    Every time a hand completes a revolution, the next level's hand
+    moves forward by one slot, and its events are "cascaded" into
+    the lower levels, closer to their deadline.
+*/
+// Every event is moved at most `TLevels - 1` times before
+// expiring, and ticks without expiring events only look at a
+// single empty slot: the cost is proportional to the number of
+// expired events, not to the number of scheduled ones.
+
+template <std::size_t TLevels = 4, std::size_t TSlotBits = 6>
+class TimingWheel
+{
+private:
+    static constexpr std::size_t slotCount{1u << TSlotBits};
+    static constexpr Tick slotMask{slotCount - 1};
+
+    std::vector<TimerEvent> slots[TLevels][slotCount];
+    Tick now{0};
+
+    // Events expiring during the current tick. Kept as a member so
+    // that its capacity is reused from one tick to the next.
+    std::vector<TimerEvent> expired;
+
+    static constexpr Tick getLevelSpan(std::size_t mLevel) noexcept
+    {
+        return Tick(1) << (mLevel * TSlotBits);
+    }
+
+    // Cascaded events can expire during the current tick: `advance`
+    // cascades the higher levels before visiting the level 0 slot.
+    void insert(const TimerEvent& mEvent)
+    {
+        assert(mEvent.deadline >= now);
+        auto delta(mEvent.deadline - now);
+
+        for(std::size_t l(0); l < TLevels; ++l)
+        {
+            if(delta < getLevelSpan(l + 1))
+            {
+                auto slot((mEvent.deadline >> (l * TSlotBits)) & slotMask);
+                slots[l][slot].emplace_back(mEvent);
+                return;
+            }
+        }
+
+        // The deadline is too far away: the event is put in the last
+        // slot of the last level, and will be re-inserted when it gets
+        // cascaded.
+        constexpr auto l(TLevels - 1);
+        auto slot(((now >> (l * TSlotBits)) - 1) & slotMask);
+        slots[l][slot].emplace_back(mEvent);
+    }
+
+    // Moves the events of the current slot of level `mLevel` to the
+    // lower levels.
+    void cascade(std::size_t mLevel)
+    {
+        auto& slot(slots[mLevel][(now >> (mLevel * TSlotBits)) & slotMask]);
+
+        // `insert` never adds events to the slot we're emptying.
+        auto events(std::move(slot));
+        slot.clear();
+
+        for(const auto& e : events) insert(e);
+    }
+
+public:
+    auto getNow() const noexcept { return now; }
+
+    // Newly scheduled events can't expire in the past, nor during the
+    // tick that is currently being processed: its slot has already
+    // been visited. The earliest possible deadline is the next tick.
+    void schedule(TimerEvent mEvent)
+    {
+        if(mEvent.deadline <= now) mEvent.deadline = now + 1;
+        insert(mEvent);
+    }
+
+    // Advances the wheel by one tick, calling `mFn(event)` for every
+    // expired event.
+    template <typename TF>
+    void advance(TF&& mFn)
+    {
+        ++now;
+
+        // Higher level hands move when the lower ones complete a
+        // revolution.
+        for(std::size_t l(1); l < TLevels; ++l)
+        {
+            if((now & (getLevelSpan(l) - 1)) != 0) break;
+            cascade(l);
+        }
+
+        // `mFn` can schedule new events: the expired ones are moved
+        // out of the slot before being processed. Swapping keeps the
+        // capacity of both vectors: slots don't reallocate every
+        // revolution.
+        auto& slot(slots[0][now & slotMask]);
+        expired.swap(slot);
+
+        for(const auto& e : expired) mFn(e);
+        expired.clear();
+    }
+};
+
+template <typename T>
+class Manager
+{
+    template <typename>
+    friend class Handle;
+
+private:
+    std::size_t size{0u};
+    std::size_t sizeNext{0u};
+
+    std::vector<Atom<T>> atoms;
+    std::vector<Mark> marks;
+
+    // Scheduled events of the entities of this manager.
+    TimingWheel<> wheel;
+
+    auto getCapacity() noexcept { return atoms.size(); }
+
+    void growBy(std::size_t mAmount)
+    {
+        auto oldCapacity(getCapacity());
+        auto newCapacity(oldCapacity + mAmount);
+
+        atoms.reserve(newCapacity);
+        marks.reserve(newCapacity);
+
+        for(auto i(oldCapacity); i < newCapacity; ++i)
+        {
+            atoms.emplace_back(i);
+            marks.emplace_back(i);
+        }
+    }
+
+    void destroy(HIdx mMarkIdx) noexcept
+    {
+        getAtomFromMark(marks[mMarkIdx]).setDead();
+    }
+
+    auto& getMarkFromAtom(const Atom<T>& mAtom) noexcept
+    {
+        return marks[mAtom.markIdx];
+    }
+
+    auto& getAtomFromMark(const Mark& mMark) noexcept
+    {
+        return atoms[mMark.atomIdx];
+    }
+
+    auto createHandleFromAtom(Atom<T>& mAtom) noexcept
+    {
+        return Handle<T>{*this, mAtom.markIdx, getMarkFromAtom(mAtom).ctr};
+    }
+
+    template <typename... TArgs>
+    auto& createAtom(TArgs&&... mArgs)
+    {
+        if(getCapacity() <= sizeNext) growBy(10 + getCapacity());
+
+        auto& atom(atoms[sizeNext]);
+        atom.init(std::forward<TArgs>(mArgs)...);
+        atom.alive = true;
+
+        auto& mark(getMarkFromAtom(atom));
+        mark.atomIdx = sizeNext;
+
+        ++sizeNext;
+        return atom;
+    }
+
+    void schedule(const Handle<T>& mHandle, Tick mDelay, TimerAction mAction)
+    {
+        assert(mHandle.isAlive());
+        wheel.schedule(TimerEvent{
+            mHandle.markIdx, mHandle.ctr, wheel.getNow() + mDelay, mAction});
+    }
+
+public:
+    // Only the first `size` atoms store an entity.
+    void update()
+    {
+        for(std::size_t i(0); i < size; ++i) atoms[i].get().update();
+    }
+
+    void refresh()
+    {
+        const int intSizeNext(sizeNext);
+        int iD{0};
+        int iA{intSizeNext - 1};
+
+        do
+        {
+            for(; true; ++iD)
+            {
+                if(iD > iA) goto finishRefresh;
+                if(!atoms[iD].alive) break;
+            }
+
+            for(; true; --iA)
+            {
+                if(iA <= iD) goto finishRefresh;
+                if(atoms[iA].alive) break;
+            }
+
+            std::swap(atoms[iD], atoms[iA]);
+            getMarkFromAtom(atoms[iD]).atomIdx = iD;
+            getMarkFromAtom(atoms[iA]).atomIdx = iA;
+
+            ++iD;
+            --iA;
+        } while(true);
+
+    finishRefresh:
+
+        size = sizeNext = iD;
+
+        for(; iD < intSizeNext; ++iD)
+        {
+            atoms[iD].deinit();
+            ++(getMarkFromAtom(atoms[iD]).ctr);
+        }
+    }
+
+    template <typename... TArgs>
+    auto create(TArgs&&... mArgs)
+    {
+        return createHandleFromAtom(createAtom(std::forward<TArgs>(mArgs)...));
+    }
+
+    // The entity pointed by `mHandle` will be set as dead `mDelay`
+    // ticks from now. A delay of zero means "on the next tick".
+    void destroyAfter(const Handle<T>& mHandle, Tick mDelay)
+    {
+        schedule(mHandle, mDelay, TimerAction::Destroy);
+    }
+
+    // The entity pointed by `mHandle` will be passed to the
+    // `tick` callback `mDelay` ticks from now.
+    void wakeAfter(const Handle<T>& mHandle, Tick mDelay)
+    {
+        schedule(mHandle, mDelay, TimerAction::Wake);
+    }
+
+    // Advances time by one tick. Expired "destroy" events set their
+    // entity as dead, expired "wake" events call `mOnWake(entity)`.
+    // Events whose entity died in the meantime are skipped.
+    // Like `destroy()`, the changes take effect on `refresh()`.
+    template <typename TF>
+    void tick(TF&& mOnWake)
+    {
+        wheel.advance([this, &mOnWake](const TimerEvent& mEvent)
+            {
+                const auto& mark(marks[mEvent.markIdx]);
+                if(mark.ctr != mEvent.ctr) return;
+
+                auto& atom(getAtomFromMark(mark));
+                if(!atom.alive) return;
+
+                if(mEvent.action == TimerAction::Destroy)
+                    atom.setDead();
+                else
+                    mOnWake(atom.get());
+            });
+    }
+
+    void tick()
+    {
+        tick([](T&)
+            {
+            });
+    }
+
+    auto getSize() const noexcept { return size; }
+};
+
+template <typename T>
+bool Handle<T>::isAlive() const noexcept
+{
+    return manager->marks[markIdx].ctr == ctr;
+}
+template <typename T>
+void Handle<T>::destroy() noexcept
+{
+    return manager->destroy(markIdx);
+}
+
+// The `Entity` of the previous code segments, which counts down
+// in every `update()` call.
+struct Entity
+{
+    int health;
+    Entity() : health(10 + (rndEngine() % 50)) {}
+    void update()
+    {
+        if(--health <= 0)
+        {
+            Atom<Entity>::getAtomFromData(this)->setDead();
+        }
+    }
+};
+
+// A particle that "waits, then dies". Its lifetime is handled by
+// the manager: it doesn't need to be updated at all.
+struct Particle
+{
+    float x, y;
+    int wakeCount{0};
+
+    void update() {}
+};
+
+void example()
+{
+    Manager<Particle> m;
+
+    auto h1(m.create());
+    auto h2(m.create());
+    auto h3(m.create());
+    auto h4(m.create());
+    m.refresh();
+
+    // A delay of zero: `h4` dies on the first tick.
+    m.destroyAfter(h4, 0);
+
+    m.destroyAfter(h1, 3);
+    m.wakeAfter(h2, 2);
+    m.destroyAfter(h2, 5);
+
+    // `h3` dies before its event expires: the event will be skipped.
+    m.destroyAfter(h3, 4);
+    h3.destroy();
+    m.refresh();
+
+    for(int t(1); t <= 5; ++t)
+    {
+        m.tick([&m, &h2, t](Particle& p)
+            {
+                // Events can be scheduled while the expired ones are
+                // being processed: `h2` asks to be woken up again on
+                // the next tick.
+                if(++p.wakeCount == 1) m.wakeAfter(h2, 0);
+
+                // Prints "woken up at tick 2" and "woken up at tick 3".
+                std::cout << "woken up at tick " << t << "\n";
+            });
+
+        m.refresh();
+
+        // Prints "1: 2 particle(s)", "3: 1 particle(s)" and
+        // "5: 0 particle(s)".
+        if(t == 1 || t == 3 || t == 5)
+            std::cout << t << ": " << m.getSize() << " particle(s)\n";
+    }
+
+    // Deadlines that are a multiple of `2^TSlotBits` are stored in a
+    // higher level, and cascaded into level 0 on the very tick they
+    // expire.
+    Manager<Particle> m2;
+
+    auto h5(m2.create());
+    auto h6(m2.create());
+    m2.refresh();
+
+    m2.destroyAfter(h5, 64);
+    m2.destroyAfter(h6, 4096);
+
+    for(int t(1); m2.getSize() > 0; ++t)
+    {
+        auto oldSize(m2.getSize());
+
+        m2.tick();
+        m2.refresh();
+
+        // Prints "died at tick 64" and "died at tick 4096".
+        if(m2.getSize() != oldSize)
+            std::cout << "died at tick " << t << "\n";
+    }
+}
+
+// Let's compare the two approaches.
+
+using HRClock = std::chrono::high_resolution_clock;
+
+// Runs `mManager` until all of its entities are dead. `mExpire` finds
+// the entities that have to die during a frame. The time spent in
+// `mExpire` and in `refresh()` is measured separately: `refresh()`
+// has the same cost in both approaches.
+template <typename T, typename TF>
+void benchFrames(const char* mTitle, Manager<T>& mManager, TF&& mExpire)
+{
+    HRClock::duration expireTime{0}, refreshTime{0};
+
+    int frames(0);
+    for(; mManager.getSize() > 0; ++frames)
+    {
+        auto start(HRClock::now());
+        mExpire();
+        auto mid(HRClock::now());
+        mManager.refresh();
+        auto end(HRClock::now());
+
+        expireTime += mid - start;
+        refreshTime += end - mid;
+    }
+
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+
+    std::cout << "  " << mTitle << ": "
+              << duration_cast<milliseconds>(expireTime).count()
+              << " ms, refresh(): "
+              << duration_cast<milliseconds>(refreshTime).count() << " ms ("
+              << frames << " frames)\n";
+}
+
+// Creates `mCount` entities with a random lifetime, and runs the
+// manager until all of them are dead. Creating the entities and
+// scheduling their events is not timed: only the frames are.
+void benchmark(std::size_t mCount)
+{
+    std::cout << mCount << " entities, lifetime 10-59 frames\n";
+
+    Manager<Entity> countdown;
+    for(std::size_t i(0); i < mCount; ++i) countdown.create();
+    countdown.refresh();
+
+    benchFrames("countdown, update()", countdown, [&countdown]
+        {
+            countdown.update();
+        });
+
+    // The same `Entity` type is used, so that both managers have the
+    // same memory layout: its `update()` is simply never called.
+    Manager<Entity> wheel;
+    for(std::size_t i(0); i < mCount; ++i)
+        wheel.destroyAfter(wheel.create(), 10 + (rndEngine() % 50));
+
+    wheel.refresh();
+
+    benchFrames("timing wheel, tick()", wheel, [&wheel]
+        {
+            wheel.tick();
+        });
+}
+
+int main()
+{
+    example();
+    benchmark(1000000);
+
+    return 0;
+}
+
+// A timing wheel has a resolution of one tick: events can't expire
+// "between" two frames. When a game runs with a variable frame
+// time, ticks should be advanced with a fixed time step.
+
+// Scheduled events can't be cancelled, but events pointing to dead
+// entities are skipped. To reschedule the death of an entity, the
+// entity can be woken up and schedule a new event itself.
@@ -0,0 +1,715 @@
+// Copyright (c) 2013-2015 Vittorio Romeo
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+// License: Academic Free License ("AFL") v. 3.0
+//          http://opensource.org/licenses/AFL-3.0
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Hello again!
+// Today we'll let entities "sleep".
+
+// `Manager<T>::update()` updates every alive entity, every frame.
+// In most game worlds, however, the majority of entities is idle
+// at any given moment: resting physics bodies, NPCs far away from
+// the player, closed doors...
+
+// Checking an "is sleeping" flag at the beginning of every
+// `update()` still touches every entity, and adds a branch that
+// the CPU can't predict when sleeping and awake entities are mixed.
+
+// Our manager already partitions atoms during `refresh()`: alive
+// atoms are moved before dead ones. We can partition alive atoms
+// further, moving "active" atoms before "dormant" ones:
+/*
+             00   01   02   03   04   05   06   ...
+    --------------------------------------------------
+    Atoms: | A  | A  | A  | D  | D  |xx  |xx  | ...
+    --------------------------------------------------
+           [    active    ][ dormant ][   dead   ]
+                          ^          ^
+                     activeSize     size
+*/
+// `update()` then only iterates over the active prefix: no
+// branches, and dormant entities are never touched.
+
+std::minstd_rand rndEngine;
+
+using HIdx = std::size_t;
+using HCtr = int;
+
+template <typename>
+class Manager;
+
+// `Atom`, `Mark`, `Handle` and `Manager` are the same as in the
+// previous code segments, except for the new "dormant" state.
+
+template <typename T>
+class Atom
+{
+    template <typename>
+    friend class Manager;
+
+private:
+    std::aligned_storage_t<sizeof(T), alignof(T)> data;
+    HIdx markIdx;
+    bool alive{false};
+
+    // Requested state: takes effect on the next `refresh()`.
+    bool dormant{false};
+
+public:
+    Atom(HIdx mMarkIdx) noexcept : markIdx{mMarkIdx} {}
+
+    template <typename... TArgs>
+    void init(TArgs&&... mArgs) noexcept(std::is_nothrow_constructible<T>())
+    {
+        new(&data) T(std::forward<TArgs>(mArgs)...);
+    }
+
+    void deinit() noexcept(std::is_nothrow_destructible<T>()) { get().~T(); }
+
+    T& get() noexcept { return reinterpret_cast<T&>(data); }
+    const T& get() const noexcept { return reinterpret_cast<const T&>(data); }
+
+    static Atom* getAtomFromData(T* mData) noexcept
+    {
+        auto base(reinterpret_cast<char*>(mData) - offsetof(Atom<T>, data));
+        return reinterpret_cast<Atom<T>*>(base);
+    }
+
+    void setDead() noexcept { alive = false; }
+
+    // Like `setDead`, entities can put themselves to sleep.
+    void setDormant(bool mX) noexcept { dormant = mX; }
+    bool isDormant() const noexcept { return dormant; }
+};
+
+struct Mark
+{
+    HIdx atomIdx;
+    HCtr ctr{0};
+
+    Mark(HIdx mAtomIdx) noexcept : atomIdx{mAtomIdx} {}
+};
+
+template <typename T>
+class Handle
+{
+    template <typename>
+    friend class Manager;
+
+private:
+    Manager<T>* manager;
+    HIdx markIdx;
+    HCtr ctr;
+
+    Atom<T>& getAtom() noexcept
+    {
+        assert(manager != nullptr && isAlive());
+        return manager->getAtomFromMark(manager->marks[markIdx]);
+    }
+    const Atom<T>& getAtom() const noexcept
+    {
+        assert(manager != nullptr && isAlive());
+        return manager->getAtomFromMark(manager->marks[markIdx]);
+    }
+
+public:
+    Handle(Manager<T>& mManager, HIdx mMarkIdx, HCtr mCtr) noexcept
+        : manager(&mManager),
+          markIdx{mMarkIdx},
+          ctr{mCtr}
+    {
+    }
+
+    bool isAlive() const noexcept;
+    void destroy() noexcept;
+
+    // O(1): only a flag is changed. The entity is moved in or out
+    // of the active prefix on the next `refresh()`.
+    void sleep() noexcept { getAtom().setDormant(true); }
+    void wake() noexcept { getAtom().setDormant(false); }
+    bool isDormant() const noexcept { return getAtom().isDormant(); }
+
+    T& operator*() noexcept { return getAtom().get(); }
+    const T& operator*() const noexcept { return getAtom().get(); }
+    T* operator->() noexcept { return &(getAtom().get()); }
+    const T* operator->() const noexcept { return &(getAtom().get()); }
+};
+
+template <typename T>
+class Manager
+{
+    template <typename>
+    friend class Handle;
+
+private:
+    // Number of active atoms. (always at the beginning)
+    std::size_t activeSize{0u};
+
+    std::size_t size{0u};
+    std::size_t sizeNext{0u};
+
+    std::vector<Atom<T>> atoms;
+    std::vector<Mark> marks;
+
+    auto getCapacity() noexcept { return atoms.size(); }
+
+    void growBy(std::size_t mAmount)
+    {
+        auto oldCapacity(getCapacity());
+        auto newCapacity(oldCapacity + mAmount);
+
+        atoms.reserve(newCapacity);
+        marks.reserve(newCapacity);
+
+        for(auto i(oldCapacity); i < newCapacity; ++i)
+        {
+            atoms.emplace_back(i);
+            marks.emplace_back(i);
+        }
+    }
+
+    void destroy(HIdx mMarkIdx) noexcept
+    {
+        getAtomFromMark(marks[mMarkIdx]).setDead();
+    }
+
+    auto& getMarkFromAtom(const Atom<T>& mAtom) noexcept
+    {
+        return marks[mAtom.markIdx];
+    }
+
+    auto& getAtomFromMark(const Mark& mMark) noexcept
+    {
+        return atoms[mMark.atomIdx];
+    }
+
+    auto createHandleFromAtom(Atom<T>& mAtom) noexcept
+    {
+        return Handle<T>{*this, mAtom.markIdx, getMarkFromAtom(mAtom).ctr};
+    }
+
+    template <typename... TArgs>
+    auto& createAtom(TArgs&&... mArgs)
+    {
+        if(getCapacity() <= sizeNext) growBy(10 + getCapacity());
+
+        auto& atom(atoms[sizeNext]);
+        atom.init(std::forward<TArgs>(mArgs)...);
+        atom.alive = true;
+        atom.dormant = false;
+
+        auto& mark(getMarkFromAtom(atom));
+        mark.atomIdx = sizeNext;
+
+        ++sizeNext;
+        return atom;
+    }
+
+    // Swaps two atoms, keeping their marks connected.
+    void swapAtoms(HIdx mA, HIdx mB) noexcept
+    {
+        if(mA == mB) return;
+
+        std::swap(atoms[mA], atoms[mB]);
+        getMarkFromAtom(atoms[mA]).atomIdx = mA;
+        getMarkFromAtom(atoms[mB]).atomIdx = mB;
+    }
+
+    // The two-iterator partition of the previous code segments,
+    // generalized: moves the atoms satisfying `mPred` before the
+    // other ones, in the `[mBegin, mEnd)` range. Returns the index
+    // of the first atom not satisfying `mPred`.
+    // Atoms that are already in the correct half are never moved:
+    // the number of swaps only depends on the misplaced atoms.
+    template <typename TF>
+    HIdx partition(HIdx mBegin, HIdx mEnd, TF&& mPred) noexcept
+    {
+        HIdx iL{mBegin}, iR{mEnd};
+
+        while(true)
+        {
+            for(; iL < iR && mPred(atoms[iL]); ++iL)
+            {
+            }
+
+            for(; iL < iR && !mPred(atoms[iR - 1]); --iR)
+            {
+            }
+
+            if(iL >= iR) return iL;
+            swapAtoms(iL++, --iR);
+        }
+    }
+
+public:
+    Manager() = default;
+
+    Manager(const Manager&) = delete;
+    Manager& operator=(const Manager&) = delete;
+
+    // Every atom before `sizeNext` holds a constructed entity,
+    // including the dead ones that haven't been refreshed yet.
+    ~Manager()
+    {
+        for(std::size_t i(0); i < sizeNext; ++i) atoms[i].deinit();
+    }
+
+    // Only active atoms are updated.
+    void update()
+    {
+        for(std::size_t i(0); i < activeSize; ++i) atoms[i].get().update();
+    }
+
+    // `refresh()` now partitions the atoms twice:
+    // 1. Alive atoms before dead ones, as before.
+    // 2. Among alive atoms, active ones before dormant ones.
+    // Waking up or putting to sleep an entity only misplaces its
+    // own atom: a frame where few entities change state performs
+    // few swaps.
+    void refresh()
+    {
+        const auto oldSizeNext(sizeNext);
+
+        size = sizeNext = partition(0, oldSizeNext, [](const auto& mA)
+            {
+                return mA.alive;
+            });
+
+        activeSize = partition(0, size, [](const auto& mA)
+            {
+                return !mA.dormant;
+            });
+
+        for(auto i(size); i < oldSizeNext; ++i)
+        {
+            atoms[i].deinit();
+            ++(getMarkFromAtom(atoms[i]).ctr);
+        }
+    }
+
+    template <typename... TArgs>
+    auto create(TArgs&&... mArgs)
+    {
+        return createHandleFromAtom(createAtom(std::forward<TArgs>(mArgs)...));
+    }
+
+    auto getSize() const noexcept { return size; }
+    auto getActiveSize() const noexcept { return activeSize; }
+};
+
+template <typename T>
+bool Handle<T>::isAlive() const noexcept
+{
+    return manager->marks[markIdx].ctr == ctr;
+}
+template <typename T>
+void Handle<T>::destroy() noexcept
+{
+    return manager->destroy(markIdx);
+}
+
+// A physics body that falls asleep when it stops moving.
+struct Body
+{
+    float x{0.f}, y{0.f}, vx, vy;
+
+    Body(float mVX = 1.f, float mVY = 1.f) : vx{mVX}, vy{mVY} {}
+
+    void update()
+    {
+        x += vx;
+        y += vy;
+
+        vx *= 0.5f;
+        vy *= 0.5f;
+
+        if(vx * vx + vy * vy < 0.0001f)
+            Atom<Body>::getAtomFromData(this)->setDormant(true);
+    }
+};
+
+void example()
+{
+    Manager<Body> m;
+
+    auto h1(m.create(1.f, 0.f));
+    auto h2(m.create(0.f, 0.f));
+    m.refresh();
+
+    // Prints "2 active".
+    std::cout << m.getActiveSize() << " active\n";
+
+    // `h2` isn't moving: it puts itself to sleep.
+    m.update();
+    m.refresh();
+
+    // Prints "1 active".
+    std::cout << m.getActiveSize() << " active\n";
+
+    // Something hits `h2`: it wakes up on the next refresh.
+    h2.wake();
+    h2->vx = 10.f;
+    m.refresh();
+
+    // Prints "2 active".
+    std::cout << m.getActiveSize() << " active\n";
+
+    // Dormant entities can still die.
+    h1.sleep();
+    m.refresh();
+    h1.destroy();
+    m.refresh();
+
+    // Prints "1 active, 1 alive".
+    std::cout << m.getActiveSize() << " active, " << m.getSize()
+              << " alive\n";
+}
+
+// Let's audit the lifetime of the entities stored in the manager,
+// with the instrumented type from `DiveIntoC++14/1_CPP14/p7.cpp`.
+
+struct LifetimeCounts
+{
+    std::size_t constructions{0};
+    std::size_t copies{0};
+    std::size_t moves{0};
+    std::size_t copyAssignments{0};
+    std::size_t moveAssignments{0};
+    std::size_t destructions{0};
+
+    // "Named parameter" setters, to write expectations readably:
+    // `LifetimeCounts{}.constructed(1).moved(1).destroyed(2)`.
+    auto& constructed(std::size_t mX)
+    {
+        constructions = mX;
+        return *this;
+    }
+    auto& copied(std::size_t mX)
+    {
+        copies = mX;
+        return *this;
+    }
+    auto& moved(std::size_t mX)
+    {
+        moves = mX;
+        return *this;
+    }
+    auto& copyAssigned(std::size_t mX)
+    {
+        copyAssignments = mX;
+        return *this;
+    }
+    auto& moveAssigned(std::size_t mX)
+    {
+        moveAssignments = mX;
+        return *this;
+    }
+    auto& destroyed(std::size_t mX)
+    {
+        destructions = mX;
+        return *this;
+    }
+
+    // Objects that were created but never destroyed.
+    auto alive() const noexcept
+    {
+        return constructions + copies + moves - destructions;
+    }
+
+    bool operator==(const LifetimeCounts& mX) const noexcept
+    {
+        return constructions == mX.constructions && copies == mX.copies &&
+               moves == mX.moves &&
+               copyAssignments == mX.copyAssignments &&
+               moveAssignments == mX.moveAssignments &&
+               destructions == mX.destructions;
+    }
+};
+
+std::ostream& operator<<(std::ostream& mS, const LifetimeCounts& mX)
+{
+    return mS << "{constructions: " << mX.constructions
+              << ", copies: " << mX.copies << ", moves: " << mX.moves
+              << ", copy assignments: " << mX.copyAssignments
+              << ", move assignments: " << mX.moveAssignments
+              << ", destructions: " << mX.destructions << "}";
+}
+
+// Every `TTag` gets its own counters: different instrumented types can
+// be used in the same test without interfering with each other.
+template <typename TTag = void>
+struct Instrumented
+{
+    int value;
+
+    // A variable template would be nice here, but static data members
+    // of class templates can't be declared `inline` in C++14.
+    static auto& counts() noexcept
+    {
+        static LifetimeCounts result;
+        return result;
+    }
+
+    Instrumented(int mValue = 0) noexcept : value{mValue}
+    {
+        ++counts().constructions;
+    }
+
+    Instrumented(const Instrumented& mX) noexcept : value{mX.value}
+    {
+        ++counts().copies;
+    }
+
+    // Move operations are `noexcept`, like in any well-behaved type:
+    // otherwise `std::vector` would copy elements when it grows.
+    Instrumented(Instrumented&& mX) noexcept : value{mX.value}
+    {
+        ++counts().moves;
+    }
+
+    Instrumented& operator=(const Instrumented& mX) noexcept
+    {
+        value = mX.value;
+        ++counts().copyAssignments;
+        return *this;
+    }
+
+    Instrumented& operator=(Instrumented&& mX) noexcept
+    {
+        value = mX.value;
+        ++counts().moveAssignments;
+        return *this;
+    }
+
+    ~Instrumented() { ++counts().destructions; }
+};
+
+// Runs `mFn` and compares the counts of `Instrumented<TTag>` with
+// `mExpected`. Also reports objects that were leaked by `mFn`.
+// Returns `true` on success.
+template <typename TTag = void, typename TF>
+bool checkLifetime(
+    const char* mTitle, const LifetimeCounts& mExpected, TF&& mFn)
+{
+    auto& counts(Instrumented<TTag>::counts());
+    counts = LifetimeCounts{};
+
+    mFn();
+
+    bool ok(counts == mExpected && counts.alive() == 0);
+    std::cout << (ok ? "  OK   " : "  FAIL ") << mTitle << "\n";
+
+    if(!ok)
+    {
+        std::cout << "       expected: " << mExpected << "\n"
+                  << "       actual:   " << counts << "\n";
+    }
+
+    return ok;
+}
+
+struct AuditedBody : Instrumented<AuditedBody>
+{
+    void update() {}
+};
+
+// `compile.sh` defines `NDEBUG`: `checkLifetime` reports failures on
+// its own, without `assert`.
+bool audit()
+{
+    using C = AuditedBody;
+    bool ok(true);
+
+    // More entities than the initial capacity: the atom storage grows
+    // twice. Entities are constructed in place, and growing relocates
+    // the atoms' raw storage without calling their move constructors.
+    // The manager destroys the entities that are still alive.
+    ok &= checkLifetime<C>("creation and growth",
+        LifetimeCounts{}.constructed(40).destroyed(40), []
+        {
+            Manager<C> m;
+            for(std::size_t i(0); i < 40; ++i) m.create();
+
+            m.refresh();
+        });
+
+    // Partitioning dead, dormant and active entities doesn't move them
+    // either. Entities must not store pointers to themselves.
+    ok &= checkLifetime<C>("refresh with dead and sleeping entities",
+        LifetimeCounts{}.constructed(40).destroyed(40), []
+        {
+            Manager<C> m;
+
+            std::vector<Handle<C>> handles;
+            for(std::size_t i(0); i < 40; ++i) handles.emplace_back(m.create());
+
+            m.refresh();
+
+            for(std::size_t i(0); i < 40; i += 4) handles[i].destroy();
+            for(std::size_t i(1); i < 40; i += 4) handles[i].sleep();
+
+            m.refresh();
+            m.update();
+        });
+
+    // Dead entities waiting for a `refresh()` are destroyed with the
+    // manager.
+    ok &= checkLifetime<C>("destruction before a refresh",
+        LifetimeCounts{}.constructed(40).destroyed(40), []
+        {
+            Manager<C> m;
+
+            std::vector<Handle<C>> handles;
+            for(std::size_t i(0); i < 40; ++i) handles.emplace_back(m.create());
+
+            m.refresh();
+            handles[2].destroy();
+        });
+
+    return ok;
+}
+
+// Let's compare the active prefix with a "sleeping" flag checked
+// in every `update()`.
+
+struct FlaggedBody
+{
+    float x{0.f}, y{0.f}, vx{1.f}, vy{1.f};
+    bool sleeping{false};
+
+    void update()
+    {
+        if(sleeping) return;
+
+        x += vx;
+        y += vy;
+    }
+};
+
+struct PartitionedBody
+{
+    float x{0.f}, y{0.f}, vx{1.f}, vy{1.f};
+
+    void update()
+    {
+        x += vx;
+        y += vy;
+    }
+};
+
+using HRClock = std::chrono::high_resolution_clock;
+
+template <typename TF>
+void bench(const char* mTitle, TF&& mFn)
+{
+    auto start(HRClock::now());
+    auto result(mFn());
+    auto end(HRClock::now());
+
+    auto ms(std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    std::cout << "  " << mTitle << ": " << ms.count() << " ms (" << result
+              << ")\n";
+}
+
+// One entity in `mRatio` is active. Every frame, one entity in a
+// thousand is woken up and another one is put to sleep.
+void benchmark(std::size_t mCount, std::size_t mRatio, std::size_t mFrames)
+{
+    std::cout << mFrames << " frames, " << mCount << " entities, one in "
+              << mRatio << " active\n";
+
+    // Both benchmarks toggle the same entities.
+    std::vector<std::size_t> toggles(mFrames * mCount / 1000);
+    for(auto& t : toggles) t = rndEngine() % mCount;
+
+    bench("sleeping flag", [&]
+        {
+            Manager<FlaggedBody> m;
+            std::vector<Handle<FlaggedBody>> handles;
+
+            for(std::size_t i(0); i < mCount; ++i)
+            {
+                handles.emplace_back(m.create());
+                handles.back()->sleeping = i % mRatio != 0;
+            }
+
+            m.refresh();
+
+            auto itr(toggles.begin());
+            for(std::size_t f(0); f < mFrames; ++f)
+            {
+                for(std::size_t i(0); i < mCount / 1000; ++i)
+                {
+                    auto& h(handles[*itr++]);
+                    h->sleeping = !h->sleeping;
+                }
+
+                m.update();
+                m.refresh();
+            }
+
+            return handles[0]->x;
+        });
+
+    bench("active prefix", [&]
+        {
+            Manager<PartitionedBody> m;
+            std::vector<Handle<PartitionedBody>> handles;
+
+            for(std::size_t i(0); i < mCount; ++i)
+            {
+                handles.emplace_back(m.create());
+                if(i % mRatio != 0) handles.back().sleep();
+            }
+
+            m.refresh();
+
+            auto itr(toggles.begin());
+            for(std::size_t f(0); f < mFrames; ++f)
+            {
+                for(std::size_t i(0); i < mCount / 1000; ++i)
+                {
+                    auto& h(handles[*itr++]);
+                    if(h.isDormant())
+                        h.wake();
+                    else
+                        h.sleep();
+                }
+
+                m.update();
+                m.refresh();
+            }
+
+            return handles[0]->x;
+        });
+}
+
+int main()
+{
+    example();
+
+    // A non-zero exit code makes the audit usable as an automated test.
+    if(!audit()) return 1;
+
+    benchmark(1000000, 10, 100);
+    return 0;
+}
+
+// `refresh()` still visits every alive atom to partition them: its
+// cost doesn't depend on the number of active entities. Only
+// `update()` gets cheaper - which is where most of the time is spent
+// when entities perform real work.
+
+// A dormant entity can also be woken up by the timing wheel of the
+// previous code segment: a "wake" event is simply a call to
+// `wake()` on the entity's handle.